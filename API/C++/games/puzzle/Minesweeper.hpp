@@ -0,0 +1,577 @@
+/* Minesweeper Kit C++ API - Minesweeper.hpp
+   __  __
+  /  \/  \  __ ___  ____   ______ __ ______ ____ ____  ____ ____
+ /	  \(__)   \/  -_)_/  _/  /  / /  -_)  -_)  _ \/  -_)  _/
+/___/__/__/__/__/_/\___/____/ |______/\___/\___/  ___/\___/__/
+(C) 2012-2018 Manuel Sainz de Baranda y Goñi. /__/
+Released under the terms of the GNU Lesser General Public License v3. */
+
+#ifndef __games_puzzle_Minesweeper_HPP__
+#define __games_puzzle_Minesweeper_HPP__
+
+#include <Z/functions/base/Z2D.h>
+
+#ifdef MINESWEEPER_USE_LOCAL_HEADER
+#	include "Minesweeper.h"
+#else
+#	include <games/puzzle/Minesweeper.h>
+#endif
+
+#ifdef MINESWEEPER_USE_C_STANDARD_LIBRARY
+#	include <cstdlib>
+#	include <cstring>
+#else
+#	include <ZBase/block.h>
+#	include <ZSystem/randomness.h>
+#endif
+
+/*-----------------------------------------------------------------------------.
+| Header-only engine for boards whose geometry is known at compile time. It    |
+| uses the cell encoding and the snapshot format of the C API, and consumes    |
+| the random number generator in the same order as `minesweeper_disclose` and  |
+| `minesweeper_hint`, so with the same seed both produce the same games.       |
+|									       |
+| The matrix is stored with a one-cell border of sentinels (FLAG cells) so     |
+| the neighbours of any cell are reached through constant offsets without      |
+| bounds checks. Cells are addressed as in the C API: (y * X + x) for the      |
+| public accessors and the snapshots.					       |
+|									       |
+| The hints do not scan the matrix. Bitsets indexed like it track the cells    |
+| (covered cells free of flags and mines, cells with warning and disclosed     |
+| cells) at the cost of a bit operation per changed cell, and the candidates   |
+| of each case are counted and selected a 64-bit word at a time. The cells     |
+| next to a disclosed one are found by dilating the disclosed bitset.	       |
+'=============================================================================*/
+
+template <zuint X, zuint Y, zuint MINE_COUNT> class MinesweeperFixed {
+	enum {	STRIDE	      = X + 2,
+		CELL_COUNT    = X * Y,
+		PADDED_COUNT  = STRIDE * (Y + 2),
+		WORD_COUNT    = (PADDED_COUNT + 63) / 64,
+		ROW_WORDS     = STRIDE / 64,
+		ROW_BITS      = STRIDE % 64,
+		HEADER_SIZE   = sizeof(MinesweeperSnapshotHeader),
+		SNAPSHOT_SIZE = HEADER_SIZE + CELL_COUNT,
+		EXPLODED      = MINESWEEPER_CELL_MASK_EXPLODED,
+		MINE	      = MINESWEEPER_CELL_MASK_MINE,
+		DISCLOSED     = MINESWEEPER_CELL_MASK_DISCLOSED,
+		FLAG	      = MINESWEEPER_CELL_MASK_FLAG,
+		WARNING	      = MINESWEEPER_CELL_MASK_WARNING
+	};
+
+	typedef char static_assertion_size
+		[	X >= MINESWEEPER_MINIMUM_X_SIZE &&
+			Y >= MINESWEEPER_MINIMUM_Y_SIZE &&
+			MINE_COUNT >= MINESWEEPER_MINIMUM_MINE_COUNT &&
+			MINE_COUNT <= X * Y - 9 &&
+			(zuint)PADDED_COUNT <= 65536
+		 ? 1 : -1];
+
+	MinesweeperCell	 _matrix[PADDED_COUNT];
+	zuint64		 _cells	   [WORD_COUNT];
+	zuint64		 _free	   [WORD_COUNT];
+	zuint64		 _warnings [WORD_COUNT];
+	zuint64		 _disclosed[WORD_COUNT];
+	zuint		 _remaining_count;
+	zuint		 _flag_count;
+	MinesweeperState _state;
+
+	static zuint random()
+		{
+#		ifdef MINESWEEPER_USE_C_STANDARD_LIBRARY
+			return (zuint)::random();
+#		else
+			return (zuint)z_random();
+#		endif
+		}
+
+	static zuint index(zuint x, zuint y)
+		{return (y + 1) * STRIDE + x + 1;}
+
+	static zuint cell_x(zuint index)
+		{return index % STRIDE - 1;}
+
+	static zuint cell_y(zuint index)
+		{return index / STRIDE - 1;}
+
+	static zuint64 bit(zuint index)
+		{return (zuint64)1 << (index & 63);}
+
+
+	static zuint population(zuint64 word)
+		{
+		word -= (word >> 1) & 0x5555555555555555ULL;
+		word  = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+		word  = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+		return (zuint)((word * 0x0101010101010101ULL) >> 56);
+		}
+
+
+	/*---------------------------------------------------------.
+	| Position of the set bit of `word` that has `rank` set	   |
+	| bits above it, found by halving the range in six steps.  |
+	'---------------------------------------------------------*/
+	static zuint select_bit(zuint64 word, zuint rank)
+		{
+		zuint base = 0, width, count;
+
+		for (width = 32; width; width /= 2)
+			{
+			count = population((word >> (base + width)) & (((zuint64)1 << width) - 1));
+			if (rank < count) base += width; else rank -= count;
+			}
+
+		return base;
+		}
+
+
+	static zuint64 word_at(zuint64 const *words, zsint word)
+		{return word >= 0 && word < WORD_COUNT ? words[word] : 0;}
+
+
+	void set_square(zuint64 *words, zuint center)
+		{
+		zuint row, end;
+
+		for (row = center - STRIDE - 1, end = row + 3 * STRIDE; row != end; row += STRIDE)
+			{
+			words[row >> 6] |= (zuint64)7 << (row & 63);
+			if ((row & 63) > 61) words[(row >> 6) + 1] |= (zuint64)7 >> (64 - (row & 63));
+			}
+		}
+
+
+	void index_disclosure(zuint index)
+		{
+		_free	  [index >> 6] &= ~bit(index);
+		_disclosed[index >> 6] |=  bit(index);
+		}
+
+
+	void index_cells()
+		{
+		MinesweeperCell cell;
+		zuint x, y, i;
+
+		for (i = 0; i < WORD_COUNT; i++) _free[i] = _warnings[i] = _disclosed[i] = 0;
+
+		for (y = 0; y < Y; y++) for (x = 0; x < X; x++)
+			{
+			cell = _matrix[i = index(x, y)];
+			if (!(cell & (DISCLOSED | FLAG | MINE))) _free	    [i >> 6] |= bit(i);
+			if (cell & WARNING)			 _warnings [i >> 6] |= bit(i);
+			if (cell & DISCLOSED)			 _disclosed[i >> 6] |= bit(i);
+			}
+		}
+
+
+	/*------------------------------------------------------------------.
+	| Cells next to a disclosed one: the disclosed bitset dilated by a  |
+	| column to each side and then by a row up and down. The disclosed  |
+	| cells are included, but they are never candidates.		    |
+	'------------------------------------------------------------------*/
+	void find_frontier(zuint64 *frontier) const
+		{
+		zuint64 near[WORD_COUNT];
+		zsint word;
+
+		for (word = 0; word < WORD_COUNT; word++) near[word] =
+			_disclosed[word] | (_disclosed[word] << 1) | (_disclosed[word] >> 1) |
+			(word_at(_disclosed, word - 1) >> 63) | (word_at(_disclosed, word + 1) << 63);
+
+		for (word = 0; word < WORD_COUNT; word++) frontier[word] =
+			near[word] |
+			(word_at(near, word - ROW_WORDS) << ROW_BITS) |
+			(word_at(near, word + ROW_WORDS) >> ROW_BITS) |
+			(ROW_BITS != 0 ? word_at(near, word - ROW_WORDS - 1) >> ((64 - ROW_BITS) & 63) : 0) |
+			(ROW_BITS != 0 ? word_at(near, word + ROW_WORDS + 1) << ((64 - ROW_BITS) & 63) : 0);
+		}
+
+
+	void clear_sentinels()
+		{
+		MinesweeperCell *cell;
+
+		for (cell = _matrix; cell != _matrix + STRIDE; cell++)
+			cell[0] = cell[PADDED_COUNT - STRIDE] = FLAG;
+
+		for (cell = _matrix + STRIDE; cell != _matrix + PADDED_COUNT - STRIDE; cell += STRIDE)
+			cell[0] = cell[STRIDE - 1] = FLAG;
+		}
+
+
+	void place_mines(zuint but_x, zuint but_y)
+		{
+		MinesweeperCell *cell;
+		zuint x, y, count = MINE_COUNT;
+
+		while (count)
+			{
+			x = random() % X;
+			y = random() % Y;
+
+			if (	(x - but_x + 1 > 2u || y - but_y + 1 > 2u) &&
+				!(*(cell = _matrix + index(x, y)) & MINE)
+			)
+				{
+				*cell |= MINE;
+				_free[(cell - _matrix) >> 6] &= ~bit((zuint)(cell - _matrix));
+				set_square(_warnings, (zuint)(cell - _matrix));
+				cell[-STRIDE - 1]++; cell[-STRIDE]++; cell[-STRIDE + 1]++;
+				cell[-1]++;			      cell[1]++;
+				cell[ STRIDE - 1]++; cell[ STRIDE]++; cell[ STRIDE + 1]++;
+				count--;
+				}
+			}
+
+		/*-----------------------------------------------------------.
+		| The sentinels have received warnings, restore their value. |
+		'-----------------------------------------------------------*/
+		clear_sentinels();
+		_state = MINESWEEPER_STATE_PLAYING;
+		}
+
+
+	void disclose_cell(MinesweeperCell *cell)
+		{
+		zuint16 stack[CELL_COUNT], *top = stack;
+
+		*cell |= DISCLOSED;
+		_remaining_count--;
+		index_disclosure((zuint)(cell - _matrix));
+		if (*cell & WARNING) return;
+		*top++ = (zuint16)(cell - _matrix);
+
+#		define MINESWEEPER_FIXED_VISIT(offset)					\
+			if (!(cell[offset] & (DISCLOSED | FLAG)))			\
+				{							\
+				cell[offset] |= DISCLOSED;				\
+				_remaining_count--;					\
+				index_disclosure((zuint)(cell + offset - _matrix));	\
+											\
+				if (!(cell[offset] & WARNING))				\
+					*top++ = (zuint16)(cell + offset - _matrix);	\
+				}
+
+		while (top != stack)
+			{
+			cell = _matrix + *--top;
+			MINESWEEPER_FIXED_VISIT(-STRIDE - 1)
+			MINESWEEPER_FIXED_VISIT(-STRIDE	   )
+			MINESWEEPER_FIXED_VISIT(-STRIDE + 1)
+			MINESWEEPER_FIXED_VISIT(	   -1)
+			MINESWEEPER_FIXED_VISIT(	    1)
+			MINESWEEPER_FIXED_VISIT( STRIDE - 1)
+			MINESWEEPER_FIXED_VISIT( STRIDE	   )
+			MINESWEEPER_FIXED_VISIT( STRIDE + 1)
+			}
+
+#		undef MINESWEEPER_FIXED_VISIT
+		}
+
+
+	/*-------------------------------------------------------------------.
+	| Candidates of a hint case in one word: 0: covered warning next to  |
+	| a disclosed cell, 1: covered warning, 2: any covered free cell.    |
+	'-------------------------------------------------------------------*/
+	zuint64 hint_word(zuint hint_case, zuint word, zuint64 const *frontier) const
+		{
+		zuint64 value = _free[word];
+
+		if (hint_case < 2) value &= _warnings[word];
+		if (hint_case < 1) value &= frontier[word];
+		return value;
+		}
+
+
+	/*-------------------------------------------------------------.
+	| The C API scans the matrix in reverse order, so the	       |
+	| candidate with index `rank` is counted from the highest bit. |
+	'-------------------------------------------------------------*/
+	zuint find_hint(zuint hint_case, zuint rank, zuint64 const *frontier) const
+		{
+		zuint64 value;
+		zuint word, count;
+
+		for (word = WORD_COUNT; word--;)
+			{
+			count = population(value = hint_word(hint_case, word, frontier));
+			if (rank < count) break;
+			rank -= count;
+			}
+
+		return word * 64 + select_bit(value, rank);
+		}
+
+
+	public:
+
+	MinesweeperFixed()
+		{
+		zuint x, y, i;
+
+		for (i = 0; i < WORD_COUNT; i++) _cells[i] = 0;
+
+		for (y = 0; y < Y; y++) for (x = 0; x < X; x++)
+			{
+			i = index(x, y);
+			_cells[i >> 6] |= bit(i);
+			}
+
+		prepare();
+		}
+
+
+	void prepare()
+		{
+		zuint word;
+
+#		ifdef MINESWEEPER_USE_C_STANDARD_LIBRARY
+			std::memset(_matrix, 0, sizeof(_matrix));
+#		else
+			z_block_int8_set(_matrix, sizeof(_matrix), 0);
+#		endif
+
+		clear_sentinels();
+
+		for (word = 0; word < WORD_COUNT; word++)
+			{
+			_free	  [word] = _cells[word];
+			_warnings [word] = 0;
+			_disclosed[word] = 0;
+			}
+
+		_state		 = MINESWEEPER_STATE_PRISTINE;
+		_flag_count	 = 0;
+		_remaining_count = CELL_COUNT - MINE_COUNT;
+		}
+
+
+	void restart()
+		{
+		MinesweeperCell *cell;
+		zuint y;
+
+		for (y = 0; y < Y; y++)
+			for (cell = _matrix + index(0, y); cell != _matrix + index(X, y); cell++)
+				*cell &= MINE | WARNING;
+
+		index_cells();
+		if (_state > MINESWEEPER_STATE_PRISTINE) _state = MINESWEEPER_STATE_PLAYING;
+		_flag_count	 = 0;
+		_remaining_count = CELL_COUNT - MINE_COUNT;
+		}
+
+
+	static Z2DUInt size()
+		{return z_2d_type(UINT)(X, Y);}
+
+	static zuint mine_count()
+		{return MINE_COUNT;}
+
+	MinesweeperState state() const
+		{return _state;}
+
+	zuint flag_count() const
+		{return _flag_count;}
+
+	zuint remaining_count() const
+		{return _remaining_count;}
+
+	zuint disclosed_count() const
+		{return CELL_COUNT - MINE_COUNT - _remaining_count;}
+
+	zuint covered_count() const
+		{return CELL_COUNT - disclosed_count();}
+
+	MinesweeperCell cell(zuint x, zuint y) const
+		{return _matrix[index(x, y)];}
+
+
+	MinesweeperResult disclose(zuint x, zuint y)
+		{
+		MinesweeperCell *cell = _matrix + index(x, y);
+
+		if (_state == MINESWEEPER_STATE_PRISTINE) place_mines(x, y);
+		if (*cell & DISCLOSED) return MINESWEEPER_RESULT_ALREADY_DISCLOSED;
+		if (*cell & FLAG     ) return MINESWEEPER_RESULT_IS_FLAG;
+
+		if (*cell & MINE)
+			{
+			*cell |= DISCLOSED | EXPLODED;
+			_disclosed[(cell - _matrix) >> 6] |= bit((zuint)(cell - _matrix));
+			_state = MINESWEEPER_STATE_EXPLODED;
+			return MINESWEEPER_RESULT_MINE_FOUND;
+			}
+
+		disclose_cell(cell);
+
+		if (!_remaining_count)
+			{
+			_state = MINESWEEPER_STATE_SOLVED;
+			return MINESWEEPER_RESULT_SOLVED;
+			}
+
+		return Z_OK;
+		}
+
+
+	MinesweeperResult toggle_flag(zuint x, zuint y, zboolean *new_value = NULL)
+		{
+		MinesweeperCell *cell = _matrix + index(x, y);
+
+		if (*cell & DISCLOSED) return MINESWEEPER_RESULT_ALREADY_DISCLOSED;
+		if (*cell & FLAG) _flag_count--; else _flag_count++;
+		*cell ^= FLAG;
+
+		if (!(*cell & MINE))
+			_free[(cell - _matrix) >> 6] ^= bit((zuint)(cell - _matrix));
+
+		if (new_value != NULL) *new_value = !!(*cell & FLAG);
+		return Z_OK;
+		}
+
+
+	void disclose_all_mines()
+		{
+		zuint x, y, i;
+
+		for (y = 0; y < Y; y++) for (x = 0; x < X; x++)
+			if (_matrix[i = index(x, y)] & MINE)
+				{
+				_matrix[i] |= DISCLOSED;
+				_disclosed[i >> 6] |= bit(i);
+				}
+		}
+
+
+	void flag_all_mines()
+		{
+		zuint x, y;
+
+		for (y = 0; y < Y; y++) for (x = 0; x < X; x++)
+			if (_matrix[index(x, y)] & MINE) _matrix[index(x, y)] |= FLAG;
+		}
+
+
+	zboolean hint(Z2DUInt *coordinates)
+		{
+		zuint64 frontier[WORD_COUNT];
+		zuint hint_case, word, count, found;
+
+		if (	_state == MINESWEEPER_STATE_EXPLODED ||
+			_state == MINESWEEPER_STATE_SOLVED
+		)
+			return FALSE;
+
+		if (_state == MINESWEEPER_STATE_PRISTINE)
+			{
+			/*---------------------------------------------------------.
+			| Same expression as in the C API, so that the compiler    |
+			| evaluates the two calls to the generator in the same     |
+			| (unspecified) order.					   |
+			'---------------------------------------------------------*/
+			*coordinates = z_2d_type(UINT)(random() % X, random() % Y);
+			place_mines(coordinates->x, coordinates->y);
+			return TRUE;
+			}
+
+		find_frontier(frontier);
+
+		for (hint_case = 0; hint_case < 3; hint_case++)
+			{
+			for (count = 0, word = 0; word < WORD_COUNT; word++)
+				count += population(hint_word(hint_case, word, frontier));
+
+			if (count)
+				{
+				found	       = find_hint(hint_case, random() % count, frontier);
+				coordinates->x = cell_x(found);
+				coordinates->y = cell_y(found);
+				return TRUE;
+				}
+			}
+
+		return FALSE;
+		}
+
+
+	void resolve()
+		{
+		zuint x, y;
+
+		for (y = 0; y < Y; y++) for (x = 0; x < X; x++)
+			if (!(_matrix[index(x, y)] & MINE)) _matrix[index(x, y)] |= DISCLOSED;
+
+		_remaining_count = 0;
+		index_cells();
+		}
+
+
+	zusize snapshot_size() const
+		{return _state > MINESWEEPER_STATE_PRISTINE ? SNAPSHOT_SIZE : HEADER_SIZE;}
+
+
+	void snapshot(void *output) const
+		{
+		MinesweeperSnapshotHeader *header = (MinesweeperSnapshotHeader *)output;
+		MinesweeperCell *matrix = (MinesweeperCell *)output + HEADER_SIZE;
+		zuint x, y;
+
+		header->x	   = z_uint64_big_endian((zuint64)X);
+		header->y	   = z_uint64_big_endian((zuint64)Y);
+		header->mine_count = z_uint64_big_endian((zuint64)MINE_COUNT);
+		header->state	   = _state;
+
+		if (_state > MINESWEEPER_STATE_PRISTINE)
+			for (y = 0; y < Y; y++) for (x = 0; x < X; x++)
+				*matrix++ = _matrix[index(x, y)];
+		}
+
+
+	/*-------------------------------------------------------------.
+	| Accepts only snapshots of this geometry; the contents are    |
+	| validated with `minesweeper_snapshot_test`.		       |
+	'-------------------------------------------------------------*/
+	ZStatus set_snapshot(void const *snapshot, zusize snapshot_size)
+		{
+		Z2DUInt snapshot_board_size;
+		zuint snapshot_mine_count, x, y;
+		MinesweeperState state;
+		MinesweeperCell const *matrix = (MinesweeperCell const *)snapshot + HEADER_SIZE;
+		ZStatus status = minesweeper_snapshot_test(snapshot, snapshot_size);
+
+		if (status) return status;
+
+		minesweeper_snapshot_values
+			(snapshot, NULL, &snapshot_board_size, &snapshot_mine_count, &state);
+
+		if (	snapshot_board_size.x != X || snapshot_board_size.y != Y ||
+			snapshot_mine_count != MINE_COUNT
+		)
+			return Z_ERROR_INVALID_VALUE;
+
+		prepare();
+		_state = state;
+
+		if (state > MINESWEEPER_STATE_PRISTINE)
+			for (y = 0; y < Y; y++) for (x = 0; x < X; x++)
+				{
+				MinesweeperCell cell = _matrix[index(x, y)] = *matrix++;
+
+				if (cell & FLAG) _flag_count++;
+				if ((cell & DISCLOSED) && !(cell & MINE)) _remaining_count--;
+				}
+
+		if (state > MINESWEEPER_STATE_PRISTINE) index_cells();
+		return Z_OK;
+		}
+};
+
+
+typedef MinesweeperFixed< 9,  9, 10> MinesweeperBeginner;
+typedef MinesweeperFixed<16, 16, 40> MinesweeperIntermediate;
+typedef MinesweeperFixed<30, 16, 99> MinesweeperExpert;
+
+
+#endif /* __games_puzzle_Minesweeper_HPP__ */
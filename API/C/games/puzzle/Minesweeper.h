@@ -62,18 +62,75 @@ typedef struct Minesweeper Minesweeper;
 						MinesweeperCell	   cell_value);
 #endif
 
+/*-------------------------------------------------------------------------.
+| A layout source is asked for the mines of the board when the first cell  |
+| is disclosed. It must write `mine_count` distinct cell indices	   |
+| (y * size.x + x) of a board of the same size with no mines in the	   |
+| `safe_size` rectangle at (0, 0), or return FALSE to let the library	   |
+| place them. The rectangle is the part of the 3x3 square around the first |
+| cell that lies on the board: 3x3 off the border, 2x3 or 3x2 on a border  |
+| and 2x2 on a corner. Along each axis the layout is then shifted	   |
+| cyclically if the cell is off the border, or mirrored if it is on the	   |
+| far border, which moves the rectangle under the cell. Both maps are	   |
+| bijections of the cells, so the mines keep the distribution of the	   |
+| library's placement.							   |
+'=========================================================================*/
+
+#ifdef MINESWEEPER_USE_LAYOUT_SOURCE
+	typedef zboolean (* MinesweeperLayoutSource)(void*		context,
+						     Minesweeper const* minesweeper,
+						     Z2DUInt		safe_size,
+						     zuint*		mines);
+#endif
+
+/*-------------------------------------------------------------------------.
+| `matrix` points to the cell (0, 0) of a padded layout whose rows are	   |
+| `stride` cells apart, so the cell (x, y) is `matrix[y * stride + x]`.    |
+| Use `minesweeper_cell` or `minesweeper_export_matrix` to read the cells  |
+| without depending on the layout.					   |
+|									   |
+| With `lazy_warnings` enabled, the first disclosure only draws how many   |
+| mines each block of rows gets (`block_mines`) and places those of the	   |
+| blocks around the cell. The mines of the other blocks are placed and the |
+| warnings computed the first time a game function reads the block or one  |
+| next to it; `materialized_blocks` has one bit per block. The cells read  |
+| directly through `matrix` may not have their mines or warnings yet.	   |
+|									   |
+| `layout_mines` is where the layout source writes the mines. It is grown  |
+| by `minesweeper_prepare` and reused by the following games, so the first |
+| disclosure does not allocate; if it cannot grow, the library places the  |
+| mines itself.								   |
+'=========================================================================*/
+
 struct Minesweeper {
 	MinesweeperCell* matrix;
+	zuint8*		 dirty_rows;
+	zuint8*		 played_rows;
+	zuint8*		 materialized_blocks;
+	zuint*		 block_mines;
+	zuint*		 openings;
 	Z2DUInt		 size;
+	zuint		 stride;
 	zuint		 mine_count;
 	zuint		 remaining_count;
 	zuint		 flag_count;
+	zuint		 zero_count;
+	zuint		 opening_count;
+	zuint		 bbbv;
 	MinesweeperState state;
+	zboolean	 lazy_warnings;
 
 #	ifdef MINESWEEPER_USE_CALLBACK
 		MinesweeperCellUpdated cell_updated;
 		void*		       cell_updated_context;
 #	endif
+
+#	ifdef MINESWEEPER_USE_LAYOUT_SOURCE
+		MinesweeperLayoutSource layout_source;
+		void*			layout_source_context;
+		zuint*			layout_mines;
+		zuint			layout_capacity;
+#	endif
 };
 
 Z_DEFINE_STRICT_STRUCTURE(
@@ -93,6 +150,29 @@ MINESWEEPER_API ZStatus		  minesweeper_prepare		(Minesweeper*	    object,
 								 Z2DUInt	    size,
 								 zuint		    mine_count);
 
+MINESWEEPER_API void		  minesweeper_restart		(Minesweeper*	    object);
+
+MINESWEEPER_API void		  minesweeper_set_lazy_warnings	(Minesweeper*	    object,
+								 zboolean	    value);
+
+MINESWEEPER_API MinesweeperCell	  minesweeper_cell		(Minesweeper const* object,
+								 Z2DUInt	    coordinates);
+
+MINESWEEPER_API void		  minesweeper_export_matrix	(Minesweeper const* object,
+								 MinesweeperCell*   output);
+
+/*-------------------------------------------------------------------------.
+| `minesweeper_opening_count` and `minesweeper_3bv` return 0 when they are |
+| unavailable: before the first disclosure or if the openings index cannot |
+| be built. A board can have no openings, but its 3BV is at least 1, so	   |
+| `minesweeper_3bv` is the one to test: if it returns 0, the opening count |
+| is unavailable too; otherwise a count of 0 means there is no opening.	   |
+'=========================================================================*/
+
+MINESWEEPER_API zuint		  minesweeper_opening_count	(Minesweeper const* object);
+
+MINESWEEPER_API zuint		  minesweeper_3bv		(Minesweeper const* object);
+
 MINESWEEPER_API zuint		  minesweeper_covered_count	(Minesweeper const* object);
 
 MINESWEEPER_API zuint		  minesweeper_disclosed_count	(Minesweeper const* object);
@@ -128,6 +208,12 @@ MINESWEEPER_API ZStatus		  minesweeper_set_snapshot	(Minesweeper*	    object,
 								   void*	cell_updated_context);
 #endif
 
+#ifdef MINESWEEPER_USE_LAYOUT_SOURCE
+	MINESWEEPER_API void minesweeper_set_layout_source(Minesweeper* object,
+							   void*	layout_source,
+							   void*	layout_source_context);
+#endif
+
 MINESWEEPER_API ZStatus minesweeper_snapshot_test  (void const*	      snapshot,
 						    zusize	      snapshot_size);
 
@@ -1,3 +1,13 @@
+newoption {
+	trigger	    = "with-daemon",
+	description = "Also build the reference game daemon and its load generator (Linux)"
+}
+
+newoption {
+	trigger	    = "with-fixed-tools",
+	description = "Also build the C/C++ equivalence check and benchmark of MinesweeperFixed"
+}
+
 solution "Minesweeper"
 	configurations {"Release-Dynamic", "Release-Static", "Debug-Dynamic", "Debug-Static"}
 
@@ -22,3 +32,88 @@ solution "Minesweeper"
 		configuration "*Static"
 			kind "StaticLib"
 			defines {"MINESWEEPER_STATIC"}
+
+	if _OPTIONS["with-daemon"] then
+		-- The daemon needs the cell updated callback and the layout source,
+		-- so it builds its own copy of the library instead of linking the
+		-- one above.
+		project "minesweeperd"
+			kind "ConsoleApp"
+			language "C"
+			flags {"ExtraWarnings"}
+			buildoptions {"-std=gnu11"}
+			includedirs {"../API/C"}
+			links {"pthread"}
+
+			files {
+				"../utilities/MinesweeperDaemon.c",
+				"../utilities/MinesweeperGenerator.c",
+				"../sources/Minesweeper.c"}
+
+			defines {
+				"MINESWEEPER_STATIC",
+				"MINESWEEPER_USE_CALLBACK",
+				"MINESWEEPER_USE_LAYOUT_SOURCE",
+				"MINESWEEPER_USE_C_STANDARD_LIBRARY"}
+
+			configuration "Release*"
+				flags {"OptimizeSpeed"}
+				targetdir "bin/release"
+
+			configuration "Debug*"
+				flags {"Symbols"}
+				targetdir "bin/debug"
+
+		project "minesweeper-load"
+			kind "ConsoleApp"
+			language "C"
+			flags {"ExtraWarnings"}
+			files {"../utilities/MinesweeperLoad.c"}
+			includedirs {"../API/C"}
+			defines {"MINESWEEPER_STATIC", "MINESWEEPER_USE_C_STANDARD_LIBRARY"}
+
+			configuration "Release*"
+				flags {"OptimizeSpeed"}
+				targetdir "bin/release"
+
+			configuration "Debug*"
+				flags {"Symbols"}
+				targetdir "bin/debug"
+	end
+
+	if _OPTIONS["with-fixed-tools"] then
+		-- Both tools compare MinesweeperFixed with its own copy of the C
+		-- library, built with the standard library so the two engines
+		-- share the random() sequence.
+		project "minesweeper-fixed-check"
+			kind "ConsoleApp"
+			language "C++"
+			flags {"ExtraWarnings"}
+			files {"../utilities/MinesweeperFixedCheck.cpp", "../sources/Minesweeper.c"}
+			includedirs {"../API/C", "../API/C++"}
+			defines {"MINESWEEPER_STATIC", "MINESWEEPER_USE_C_STANDARD_LIBRARY"}
+
+			configuration "Release*"
+				flags {"OptimizeSpeed"}
+				targetdir "bin/release"
+
+			configuration "Debug*"
+				flags {"Symbols"}
+				targetdir "bin/debug"
+
+		project "minesweeper-fixed-benchmark"
+			kind "ConsoleApp"
+			language "C++"
+			flags {"ExtraWarnings"}
+			files {"../utilities/MinesweeperFixedBenchmark.cpp", "../sources/Minesweeper.c"}
+			includedirs {"../API/C", "../API/C++"}
+			defines {"MINESWEEPER_STATIC", "MINESWEEPER_USE_C_STANDARD_LIBRARY"}
+
+			configuration "Release*"
+				flags {"OptimizeSpeed"}
+				targetdir "bin/release"
+
+			configuration "Debug*"
+				flags {"Symbols"}
+				targetdir "bin/debug"
+	end
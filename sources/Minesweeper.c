@@ -23,6 +23,7 @@ Released under the terms of the GNU Lesser General Public License v3. */
 #	include <stdlib.h>
 #	include <string.h>
 
+#	define z_allocate(block_size)			  malloc(block_size)
 #	define z_deallocate(block)			  free(block)
 #	define z_reallocate(block, block_size)		  realloc(block, block_size)
 #	define z_copy(block, block_size, output)	  memcpy(output, block, block_size)
@@ -40,21 +41,57 @@ Released under the terms of the GNU Lesser General Public License v3. */
 #define MINE			    MINESWEEPER_CELL_MASK_MINE
 #define FLAG			    MINESWEEPER_CELL_MASK_FLAG
 #define WARNING			    MINESWEEPER_CELL_MASK_WARNING
+#define SENTINEL		    FLAG
+#define STRIDE_ALIGNMENT	    16
 #define HEADER(p)		    ((MinesweeperSnapshotHeader *)(p))
 #define HEADER_SIZE		    ((zusize)sizeof(MinesweeperSnapshotHeader))
-#define CELL(	    cell_x, cell_y) object->matrix[cell_y * object->size.x + cell_x]
+#define CELL(	    cell_x, cell_y) object->matrix[(zusize)(cell_y) * object->stride + (cell_x)]
 #define CELL_LOCAL( cell_x, cell_y) matrix[(cell_y) * size.x + (cell_x)]
-#define VALID(	    cell_x, cell_y) ((cell_x) < object->size.x && (cell_y) < object->size.y)
 #define VALID_LOCAL(cell_x, cell_y) ((cell_x) < size.x && (cell_y) < size.y)
-#define X(pointer)		    (((zuint)(pointer - object->matrix)) % object->size.x)
-#define Y(pointer)		    (((zuint)(pointer - object->matrix)) / object->size.x)
-#define MATRIX_END		    (object->matrix + object->size.x * object->size.y)
+#define ROW(	    cell_y)	    (&CELL(0, cell_y))
+#define ROW_END(    cell_y)	    (&CELL(object->size.x, cell_y))
+#define BLOCK			    (object->matrix - object->stride - STRIDE_ALIGNMENT)
+#define STRIDE(size_x)		    (((size_x) + STRIDE_ALIGNMENT) & ~(zuint)(STRIDE_ALIGNMENT - 1))
+#define PADDED_COUNT(stride, y)	    (STRIDE_ALIGNMENT + (zusize)(stride) * ((zusize)(y) + 2))
+#define ROW_BITMAP_SIZE(y)	    (((y) + 2 + 7) / 8)
+#define MARK_ROW(bitmap, y)	    (bitmap)[((y) + 1) >> 3] |= (zuint8)(1 << (((y) + 1) & 7))
+#define OPENING(pointer)	    object->openings[(pointer) - BLOCK]
+#define WARNING_BLOCK_ROWS	    64
+#define WARNING_BLOCK_COUNT(y)	    (((y) + WARNING_BLOCK_ROWS - 1) / WARNING_BLOCK_ROWS)
+#define BLOCK_BITMAP_SIZE(y)	    (((y) / WARNING_BLOCK_ROWS + 8) / 8)
+#define BLOCK_MINES_SIZE(y)	    ((zusize)WARNING_BLOCK_COUNT(y) * sizeof(zuint))
+
+#define BLOCK_SIZE(stride, y) \
+	(PADDED_COUNT(stride, y) + BLOCK_MINES_SIZE(y) + ROW_BITMAP_SIZE(y) * 2 + BLOCK_BITMAP_SIZE(y))
+
+#define MATERIALIZED(block)	    (object->materialized_blocks[(block) >> 3] & (1 << ((block) & 7)))
+
+#define MATERIALIZE(cell_y)						   \
+	(MATERIALIZED((cell_y) / WARNING_BLOCK_ROWS)			   \
+		? (void)0 : materialize_block(object, (cell_y) / WARNING_BLOCK_ROWS))
+#define HYPERGEOMETRIC_TAIL	    1E-20
+#define NO_OPENING		    Z_UINT_MAXIMUM
+#define FLOOD_STACK_SIZE	    256
 
-#ifndef MINESWEEPER_USE_CALLBACK
+#ifdef MINESWEEPER_USE_CALLBACK
 #	define	UPDATED(cell_point, cell) \
 		object->cell_updated(object->cell_updated_context, object, cell_point, cell)
 #endif
 
+/*----------------------------------------------------------------------------.
+| The matrix is surrounded by a border of sentinel cells: a row above, a row  |
+| below and the padding at the end of each row (which is also the left	      |
+| neighbour of the next row). Sentinels have the FLAG bit set, so they stop   |
+| the flood fill and are neither disclosed nor mines, which allows reaching   |
+| the 8 neighbours of any cell through fixed offsets without bounds checks.   |
+| The warning nibble of a sentinel is meaningless and is never read.	      |
+'============================================================================*/
+
+typedef struct {
+	MinesweeperCell* cell;
+	zuint		 y;
+} FloodEntry;
+
 static Z2DSInt8 const offsets[] = {
 	{-1, -1}, {0, -1}, {1, -1},
 	{-1,  0},	   {1,	0},
@@ -62,123 +99,627 @@ static Z2DSInt8 const offsets[] = {
 };
 
 
-static void place_mines(Minesweeper *object, Z2DUInt but)
+static void set_near_offsets(Minesweeper const *object, zsint *near_offsets)
 	{
-	MinesweeperCell *cell, *near;
 	Z2DSInt8 const *offset;
-	zuint x, y, near_x, near_y, count = object->mine_count;
 
-	while (count)
-		{
-		random_point:
-		x = RANDOM % object->size.x;
-		y = RANDOM % object->size.y;
+	for (offset = offsets; offset != offsets + 8; offset++)
+		*near_offsets++ = offset->y * (zsint)object->stride + offset->x;
+	}
 
-		if (!(x == but.x && y == but.y) && !(*(cell = &CELL(x, y)) & MINE))
-			{
-			for (offset = offsets + 8; offset-- != offsets;)
-				if (x == but.x + offset->x && y == but.y + offset->y)
-					goto random_point;
 
-			*cell |= MINE;
+static zboolean has_disclosed_neighbour(MinesweeperCell const *cell, zsint const *near_offsets)
+	{
+	return ((cell[near_offsets[0]] | cell[near_offsets[1]] | cell[near_offsets[2]] |
+		 cell[near_offsets[3]] | cell[near_offsets[4]] | cell[near_offsets[5]] |
+		 cell[near_offsets[6]] | cell[near_offsets[7]]) & DISCLOSED) != 0;
+	}
+
 
-			for (offset = offsets + 8; offset-- != offsets;)
-				if (VALID(near_x = x + offset->x, near_y = y + offset->y))
+static zuint find_root(zuint *parents, zuint index)
+	{
+	while (parents[index] != index) index = parents[index] = parents[parents[index]];
+	return index;
+	}
+
+
+/*----------------------------------------------------------------------------.
+| The openings are the connected regions of cells without mines around them.  |
+| They are found with union-find the first time they are needed, using the    |
+| first part of `openings` (one entry per padded cell) as the parent array,   |
+| so the root of each region is its first cell in row-major order. The zero   |
+| cells are then grouped by region into the list that follows, and each of    |
+| them is mapped to the position in the list of the first cell of its region. |
+| The non-zero cells and the sentinels are mapped to NO_OPENING.              |
+'============================================================================*/
+
+static void build_openings(Minesweeper *object)
+	{
+	zuint *openings = object->openings, tag = (zuint)PADDED_COUNT(object->stride, object->size.y);
+	zuint *list = openings + tag, index, near, root, value, cursor, y;
+	zsint near_offsets[8], *offset;
+	MinesweeperCell const *cell;
+
+	set_near_offsets(object, near_offsets);
+	z_block_int8_set(openings, tag * sizeof(zuint), 0xFF);
+
+	/*-----------------------------------------------------------.
+	| Union of each zero cell with the zero cells already seen   |
+	| (the 4 first offsets are the neighbours above and left).   |
+	'-----------------------------------------------------------*/
+	for (y = 0; y < object->size.y; y++)
+		for (cell = ROW(y); cell != ROW_END(y); cell++) if (!(*cell & (MINE | WARNING)))
+			{
+			index		= (zuint)(cell - BLOCK);
+			openings[index] = index;
+
+			for (offset = near_offsets; offset != near_offsets + 4; offset++)
+				if (openings[near = index + *offset] != NO_OPENING)
 					{
-					near = &CELL(near_x, near_y);
-					*near = (*near & ~WARNING) | (*near &  WARNING) + 1;
+					root  = find_root(openings, index);
+					near  = find_root(openings, near);
+
+					if	(root < near) openings[near] = root;
+					else if (near < root) openings[root] = near;
+					}
+			}
+
+	/*------------------------------------------------------------.
+	| Count the cells of each region. The roots are tagged with   |
+	| `tag + count` and the other cells point directly to them.   |
+	'------------------------------------------------------------*/
+	for (y = 0; y < object->size.y; y++)
+		for (cell = ROW(y); cell != ROW_END(y); cell++)
+			if ((root = openings[index = (zuint)(cell - BLOCK)]) != NO_OPENING)
+				{
+				if (root == index) openings[index] = tag + 1;
+
+				else	{
+					while (openings[root] < tag) root = openings[root];
+					openings[root]++;
+					openings[index] = root;
 					}
+				}
+
+	/*--------------------------------------------------------------.
+	| The roots become cursors into the list, fill the list and,    |
+	| finally, map every zero cell to the start of its region.      |
+	'--------------------------------------------------------------*/
+	object->opening_count = cursor = 0;
+
+	for (y = 0; y < object->size.y; y++)
+		for (cell = ROW(y); cell != ROW_END(y); cell++)
+			if (	(value = openings[index = (zuint)(cell - BLOCK)]) != NO_OPENING &&
+				value >= tag
+			)
+				{
+				openings[index] = tag + cursor;
+				cursor += value - tag;
+				object->opening_count++;
+				}
+
+	object->zero_count = cursor;
+
+	for (y = 0; y < object->size.y; y++)
+		for (cell = ROW(y); cell != ROW_END(y); cell++)
+			if ((root = openings[index = (zuint)(cell - BLOCK)]) != NO_OPENING)
+				{
+				if (root >= tag) root = index;
+				list[openings[root]++ - tag] = index;
+				}
+
+	for (cursor = 0, y = 0; y < object->size.y; y++)
+		for (cell = ROW(y); cell != ROW_END(y); cell++)
+			if ((value = openings[index = (zuint)(cell - BLOCK)]) != NO_OPENING)
+				{
+				if (value < tag) openings[index] = openings[value];
+
+				else	{
+					openings[index] = cursor;
+					cursor = value - tag;
+					}
+				}
+
+	/*------------------------------------------------------------------.
+	| 3BV: one click per opening plus one per numbered cell that is not |
+	| next to any opening (the AND of the 8 neighbours is NO_OPENING    |
+	| only if none of them is a zero cell).				    |
+	'------------------------------------------------------------------*/
+	object->bbbv = object->opening_count;
+
+	for (y = 0; y < object->size.y; y++)
+		for (cell = ROW(y); cell != ROW_END(y); cell++)
+			if (!(*cell & MINE) && (*cell & WARNING))
+				{
+				index = (zuint)(cell - BLOCK);
+
+				if ((	openings[index + near_offsets[0]] & openings[index + near_offsets[1]] &
+					openings[index + near_offsets[2]] & openings[index + near_offsets[3]] &
+					openings[index + near_offsets[4]] & openings[index + near_offsets[5]] &
+					openings[index + near_offsets[6]] & openings[index + near_offsets[7]]
+				) == NO_OPENING)
+					object->bbbv++;
+				}
+	}
 
+
+static void add_mine(
+	Minesweeper*	 object,
+	MinesweeperCell* cell,
+	zuint		 y,
+	zsint const*	 near_offsets
+)
+	{
+	zsint const *offset;
+
+	*cell |= MINE;
+	MARK_ROW(object->dirty_rows, y);
+
+	if (!object->lazy_warnings)
+		{
+		for (offset = near_offsets + 8; offset-- != near_offsets;) cell[*offset]++;
+		MARK_ROW(object->dirty_rows, y - 1);
+		MARK_ROW(object->dirty_rows, y + 1);
+		}
+	}
+
+
+
+/*-------------------------------------------------------------------------.
+| Places `count` mines uniformly in the rows [y, end) out of the cells	   |
+| that already have one and, if `but` is not NULL, out of the 3x3 square   |
+| centered on it (the subtractions wrap around to skip the cells outside). |
+'=========================================================================*/
+static void scatter_mines(
+	Minesweeper*	 object,
+	zuint		 y,
+	zuint		 end,
+	zuint		 count,
+	Z2DUInt const*	 but,
+	zsint const*	 near_offsets
+)
+	{
+	MinesweeperCell *cell;
+	zuint cell_x, cell_y;
+
+	while (count)
+		{
+		cell_x = RANDOM % object->size.x;
+		cell_y = y + RANDOM % (end - y);
+
+		if (	(but == NULL || cell_x - but->x + 1 > 2 || cell_y - but->y + 1 > 2) &&
+			!(*(cell = &CELL(cell_x, cell_y)) & MINE)
+		)
+			{
+			add_mine(object, cell, cell_y, near_offsets);
 			count--;
 			}
 		}
+	}
 
-	object->state = MINESWEEPER_STATE_PLAYING;
+
+static void place_block_mines(Minesweeper *object, zuint block, Z2DUInt const *but, zsint const *near_offsets)
+	{
+	zuint y = block * WARNING_BLOCK_ROWS, count = object->block_mines[block];
+
+	object->block_mines[block] = 0;
+
+	scatter_mines
+		(object, y, object->size.y - y > WARNING_BLOCK_ROWS ? y + WARNING_BLOCK_ROWS : object->size.y,
+		 count, but, near_offsets);
 	}
 
 
-static void disclose_cell(Minesweeper *object, Z2DUInt point)
+/*----------------------------------------------------------------------.
+| Computes the warnings of a block of rows from the MINE bits of their  |
+| neighbours; the sentinels never have the MINE bit set. The mines that |
+| are still to be placed in the block and in the blocks next to it are  |
+| placed first, so the MINE bits of a block are final once it or one of |
+| its neighbours is materialized.					|
+'----------------------------------------------------------------------*/
+static void materialize_block(Minesweeper *object, zuint block)
 	{
-	MinesweeperCell *cell = &CELL(point.x, point.y);
+	MinesweeperCell *cell;
+	zsint near_offsets[8];
+	zuint y = block * WARNING_BLOCK_ROWS, end = object->size.y - y > WARNING_BLOCK_ROWS
+		? y + WARNING_BLOCK_ROWS : object->size.y, near;
 
-	if (!(*cell & (DISCLOSED | FLAG)))
+	set_near_offsets(object, near_offsets);
+	object->materialized_blocks[block >> 3] |= (zuint8)(1 << (block & 7));
+
+	for (near = block ? block - 1 : 0; near <= block + 1 && near < WARNING_BLOCK_COUNT(object->size.y); near++)
+		if (object->block_mines[near]) place_block_mines(object, near, NULL, near_offsets);
+
+	for (; y != end; y++)
 		{
-		*cell |= DISCLOSED;
-		object->remaining_count--;
+		MARK_ROW(object->dirty_rows, y);
+
+		for (cell = ROW(y); cell != ROW_END(y); cell++)
+			*cell = (MinesweeperCell)((*cell & ~WARNING) | ((
+				(cell[near_offsets[0]] & MINE) + (cell[near_offsets[1]] & MINE) +
+				(cell[near_offsets[2]] & MINE) + (cell[near_offsets[3]] & MINE) +
+				(cell[near_offsets[4]] & MINE) + (cell[near_offsets[5]] & MINE) +
+				(cell[near_offsets[6]] & MINE) + (cell[near_offsets[7]] & MINE)
+			) / MINE));
+		}
+	}
 
-#		ifdef MINESWEEPER_USE_CALLBACK
-			if (object->cell_updated != NULL) UPDATED(point, *cell);
-#		endif
 
-		if (!(*cell & WARNING))
+static void materialize_warnings(Minesweeper *object)
+	{
+	zuint block = WARNING_BLOCK_COUNT(object->size.y);
+
+	while (block--) if (!MATERIALIZED(block)) materialize_block(object, block);
+	}
+
+
+/*-------------------------------------------------------------------------.
+| The openings index is built and allocated the first time it is needed,   |
+| so that it stays out of the first move; a `bbbv` of 0 means that it is   |
+| not built (every board has at least one click). It returns FALSE if the  |
+| board has no mines yet, or if the index cannot be allocated or does not  |
+| fit in `zuint` entries.						   |
+'=========================================================================*/
+static zboolean index_openings(Minesweeper *object)
+	{
+	zusize count;
+
+	if (object->state <= MINESWEEPER_STATE_PRISTINE) return FALSE;
+	if (object->bbbv) return TRUE;
+
+	if (object->openings == NULL)
+		{
+		count = PADDED_COUNT(object->stride, object->size.y) +
+			(zusize)object->size.x * object->size.y;
+
+		if (	count >= Z_UINT_MAXIMUM			     ||
+			count > Z_USIZE_MAXIMUM / sizeof(zuint)	     ||
+			(object->openings = z_allocate(count * sizeof(zuint))) == NULL
+		)
+			return FALSE;
+		}
+
+	materialize_warnings(object);
+	build_openings(object);
+	return TRUE;
+	}
+
+
+#ifdef MINESWEEPER_USE_LAYOUT_SOURCE
+
+	/*-------------------------------------------------------------------.
+	| Along each axis the safe rectangle of the layout, at 0, is moved   |
+	| under `but` by a cyclic shift when `but` is off the border (the    |
+	| rectangle is 3 cells long and does not wrap around) or by a mirror |
+	| when `but` is on the last cell (the rectangle is 2 cells long).    |
+	'-------------------------------------------------------------------*/
+	static zboolean place_layout(Minesweeper *object, Z2DUInt but, zsint const *near_offsets)
+		{
+		zuint *mine, *end, x, y;
+		Z2DUInt safe_size, shift;
+		zboolean mirror_x, mirror_y;
+
+		if (	object->layout_source == NULL ||
+			object->layout_capacity < object->mine_count
+		)
+			return FALSE;
+
+		safe_size.x = but.x && but.x != object->size.x - 1 ? 3 : 2;
+		safe_size.y = but.y && but.y != object->size.y - 1 ? 3 : 2;
+
+		if (!object->layout_source
+			(object->layout_source_context, object, safe_size, object->layout_mines)
+		)
+			return FALSE;
+
+		mirror_x = safe_size.x == 2 && but.x;
+		mirror_y = safe_size.y == 2 && but.y;
+		shift.x	 = safe_size.x == 3 ? but.x - 1 : 0;
+		shift.y	 = safe_size.y == 3 ? but.y - 1 : 0;
+
+		for (	mine = object->layout_mines, end = mine + object->mine_count;
+			mine != end; mine++
+		)
 			{
-			Z2DSInt8 const *offset = offsets + 8;
-			Z2DUInt near;
+			x = *mine % object->size.x;
+			y = *mine / object->size.x;
 
-			while (offset-- != offsets) if (
-				VALID	(near.x = point.x + offset->x,
-					 near.y = point.y + offset->y)
-			)
-				disclose_cell(object, near);
+			if (mirror_x) x = object->size.x - 1 - x;
+			else if ((x += shift.x) >= object->size.x) x -= object->size.x;
+
+			if (mirror_y) y = object->size.y - 1 - y;
+			else if ((y += shift.y) >= object->size.y) y -= object->size.y;
+
+			add_mine(object, &CELL(x, y), y, near_offsets);
 			}
+
+		return TRUE;
+		}
+
+#endif
+
+
+/*-------------------------------------------------------------------------.
+| Draws how many of `mine_count` mines placed uniformly in `cell_count`	   |
+| cells fall in `sample_size` of them, which follows the hypergeometric	   |
+| distribution. It is sampled by inversion: the probabilities are computed |
+| as ratios from the mode outwards and the tails below HYPERGEOMETRIC_TAIL |
+| of the total are dropped, so only a few standard deviations are walked.  |
+'=========================================================================*/
+static zuint draw_hypergeometric(zuint cell_count, zuint mine_count, zuint sample_size)
+	{
+	double n = sample_size, m = mine_count, free = (double)cell_count - m - n, weight, sum, target;
+	zuint low = sample_size > cell_count - mine_count ? sample_size - (cell_count - mine_count) : 0,
+	      high = sample_size < mine_count ? sample_size : mine_count, mode, top, k;
+
+	mode = (zuint)((n + 1) * (m + 1) / ((double)cell_count + 2));
+	if (mode < low) mode = low; else if (mode > high) mode = high;
+
+	for (sum = weight = 1, k = mode; k < high && weight > sum * HYPERGEOMETRIC_TAIL; k++)
+		sum += weight *= (m - k) * (n - k) / ((k + 1) * (free + k + 1));
+
+	for (top = k, weight = 1, k = mode; k > low && weight > sum * HYPERGEOMETRIC_TAIL; k--)
+		sum += weight *= k * (free + k) / ((m - k + 1) * (n - k + 1));
+
+	target	= (double)(RANDOM & 0xFFFFFF) / 16777216.0;
+	target += (double)(RANDOM & 0xFFFFFF) / 281474976710656.0;
+
+	for (target *= sum; k < top && (target -= weight) >= 0; k++)
+		weight *= (m - k) * (n - k) / ((k + 1) * (free + k + 1));
+
+	return k;
+	}
+
+
+/*-------------------------------------------------------------------------.
+| With lazy warnings, the first disclosure only draws how many mines each  |
+| block of rows gets, one block after the other among the cells left out   |
+| of the 3x3 square centered on `but`; this gives the same distribution of |
+| layouts as placing all the mines at once. The blocks with cells of that  |
+| square are placed here, the others when they are materialized.	   |
+'=========================================================================*/
+static void draw_block_mines(Minesweeper *object, Z2DUInt but, zsint const *near_offsets)
+	{
+	zuint safe_width = 1 + (but.x != 0) + (but.x != object->size.x - 1),
+	      safe_y	 = but.y ? but.y - 1 : 0,
+	      safe_end	 = but.y != object->size.y - 1 ? but.y + 2 : object->size.y,
+	      cell_count = object->size.x * object->size.y - safe_width * (safe_end - safe_y),
+	      mine_count = object->mine_count, block = 0, y = 0, end, size;
+
+	for (; mine_count; block++, y = end)
+		{
+		end  = object->size.y - y > WARNING_BLOCK_ROWS ? y + WARNING_BLOCK_ROWS : object->size.y;
+		size = object->size.x * (end - y);
+
+		if (safe_y < end && safe_end > y)
+			size -= safe_width * ((safe_end < end ? safe_end : end) - (safe_y > y ? safe_y : y));
+
+		object->block_mines[block] = end == object->size.y
+			? mine_count : draw_hypergeometric(cell_count, mine_count, size);
+
+		mine_count -= object->block_mines[block];
+		cell_count -= size;
 		}
+
+	for (block = safe_y / WARNING_BLOCK_ROWS; block <= (safe_end - 1) / WARNING_BLOCK_ROWS; block++)
+		place_block_mines(object, block, &but, near_offsets);
 	}
 
 
-static void count_hint_cases(Minesweeper const *object, zuint *counts)
+static void place_mines(Minesweeper *object, Z2DUInt but)
 	{
-	MinesweeperCell const *cell = MATRIX_END;
-	Z2DSInt8 const *offset;
-	zuint x, y, near_x, near_y;
+	zsint near_offsets[8];
+	zboolean placed = FALSE;
 
-	counts[0] = 0;
-	counts[1] = 0;
-	counts[2] = 0;
+	set_near_offsets(object, near_offsets);
+
+#	ifdef MINESWEEPER_USE_LAYOUT_SOURCE
+		placed = place_layout(object, but, near_offsets);
+#	endif
 
-	while (cell-- != object->matrix) if (!(*cell & (DISCLOSED | FLAG | MINE)))
+	if (!placed)
 		{
-		counts[2]++;
+		if (object->lazy_warnings && object->size.y > WARNING_BLOCK_ROWS)
+			draw_block_mines(object, but, near_offsets);
 
-		if (*cell & WARNING)
+		else scatter_mines(object, 0, object->size.y, object->mine_count, &but, near_offsets);
+		}
+
+	z_block_int8_set
+		(object->materialized_blocks, BLOCK_BITMAP_SIZE(object->size.y),
+		 object->lazy_warnings ? 0 : 0xFF);
+
+	object->bbbv  = 0;
+	object->state = MINESWEEPER_STATE_PLAYING;
+	}
+
+
+/*----------------------------------------------------------------------.
+| Discloses a covered cell and tells whether its neighbours must follow. |
+'----------------------------------------------------------------------*/
+static zboolean disclose_cell(Minesweeper *object, MinesweeperCell *cell, zuint y)
+	{
+	*cell |= DISCLOSED;
+	object->remaining_count--;
+	MARK_ROW(object->played_rows, y);
+	MATERIALIZE(y);
+
+#	ifdef MINESWEEPER_USE_CALLBACK
+		if (object->cell_updated != NULL)
+			UPDATED(z_2d_type(UINT)((zuint)(cell - ROW(y)), y), *cell);
+#	endif
+
+	return !(*cell & WARNING);
+	}
+
+
+/*-------------------------------------------------------------------------.
+| Iterative flood fill from a covered cell without flag. The zero cells	   |
+| are disclosed when pushed and their neighbours when popped, so no cell   |
+| is pushed twice. The stack starts in a local array and grows in the	   |
+| heap; if it cannot grow, the zero cells left out are marked with the	   |
+| EXPLODED bit (never set on a cell without mine otherwise) and gathered   |
+| again by scanning the rows once the stack is empty.			   |
+'=========================================================================*/
+static void flood_fill(Minesweeper *object, MinesweeperCell *cell, zuint y)
+	{
+	FloodEntry local[FLOOD_STACK_SIZE], *stack = local, *grown;
+	MinesweeperCell *near;
+	zsint near_offsets[8];
+	zusize size = 0, capacity = FLOOD_STACK_SIZE;
+	zuint index;
+	zboolean pending = FALSE;
+
+	if (!disclose_cell(object, cell, y)) return;
+	set_near_offsets(object, near_offsets);
+	stack->cell = cell;
+	stack->y    = y;
+	size	    = 1;
+
+	for (;;)
+		{
+		while (size)
 			{
-			counts[1]++;
-			y = Y(cell);
-			x = X(cell);
+			cell = stack[--size].cell;
+			y    = stack[size].y;
 
-			for (offset = offsets + 8; offset-- != offsets;) if (
-				VALID(near_x = x + offset->x, near_y = y + offset->y) &&
-				(CELL(near_x, near_y) & DISCLOSED)
+			for (index = 8; index--;) if (
+				!(*(near = cell + near_offsets[index]) & (DISCLOSED | FLAG)) &&
+				disclose_cell(object, near, y + offsets[index].y)
 			)
 				{
-				counts[0]++;
-				break;
+				if (size == capacity)
+					{
+					if ((grown = z_reallocate(
+						stack == local ? NULL : stack,
+						capacity * 2 * sizeof(FloodEntry))
+					) == NULL)
+						{
+						*near |= EXPLODED;
+						pending = TRUE;
+						continue;
+						}
+
+					if (stack == local) z_copy(local, sizeof(local), grown);
+					stack	  = grown;
+					capacity *= 2;
+					}
+
+				stack[size].cell   = near;
+				stack[size++].y	   = y + offsets[index].y;
 				}
 			}
+
+		if (!pending) break;
+		pending = FALSE;
+
+		for (y = 0; y < object->size.y; y++)
+			for (cell = ROW(y); cell != ROW_END(y); cell++)
+				if ((*cell & (EXPLODED | MINE)) == EXPLODED)
+					{
+					if (size == capacity) pending = TRUE;
+
+					else	{
+						*cell &= ~EXPLODED;
+						stack[size].cell = cell;
+						stack[size++].y	 = y;
+						}
+					}
 		}
+
+	if (stack != local) z_deallocate(stack);
 	}
 
 
-static Z2DUInt case0_hint(Minesweeper const *object, zuint index)
+/*-------------------------------------------------------------------.
+| Discloses in one step the opening of a zero cell and its border.   |
+| This is what the flood fill does only if every cell of the opening |
+| is covered and unflagged: a flag stops the fill, and so does a     |
+| disclosed zero cell left by an earlier fill that a flag stopped.   |
+| Otherwise it returns FALSE and does nothing.			     |
+'-------------------------------------------------------------------*/
+static zboolean disclose_opening(Minesweeper *object, MinesweeperCell *cell)
 	{
-	MinesweeperCell const *cell = MATRIX_END;
-	Z2DSInt8 const *offset;
-	zuint x, y, near_x, near_y;
+	zuint *list = object->openings + PADDED_COUNT(object->stride, object->size.y);
+	zuint start = OPENING(cell), end, index, y;
+	zsint near_offsets[9], *offset;
+	MinesweeperCell *block = BLOCK, *near;
 
-	while (cell-- != object->matrix)
-		if (!(*cell & (DISCLOSED | FLAG | MINE)) && (*cell & WARNING))
-			{
-			y = Y(cell);
-			x = X(cell);
+	for (end = start; end < object->zero_count && object->openings[list[end]] == start; end++)
+		if (block[list[end]] & (DISCLOSED | FLAG)) return FALSE;
 
-			for (offset = offsets + 8; offset-- != offsets;) if (
-				VALID(near_x = x + offset->x, near_y = y + offset->y) &&
-				(CELL(near_x, near_y) & DISCLOSED)
-			)
+	set_near_offsets(object, near_offsets);
+	near_offsets[8] = 0;
+
+	for (index = start; index != end; index++)
+		for (cell = block + list[index], offset = near_offsets + 9; offset-- != near_offsets;)
+			if (!(*(near = cell + *offset) & (DISCLOSED | FLAG)))
 				{
-				if (!index--) return z_2d_type(UINT)(x, y);
-				break;
+				*near |= DISCLOSED;
+				object->remaining_count--;
+
+#				ifdef MINESWEEPER_USE_CALLBACK
+					if (object->cell_updated != NULL) UPDATED(z_2d_type(UINT)
+						((zuint)(near - object->matrix) % object->stride,
+						 (zuint)(near - object->matrix) / object->stride),
+						*near);
+#				endif
 				}
-			}
+
+	/*-------------------------------------------------------------.
+	| The list is in row-major order, so the opening and its       |
+	| border span the rows from the first cell to the last one.    |
+	'-------------------------------------------------------------*/
+	for (	y   = (list[start  ] - STRIDE_ALIGNMENT) / object->stride - 2,
+		end = (list[end - 1] - STRIDE_ALIGNMENT) / object->stride + 1;
+		y != end; y++
+	)
+		MARK_ROW(object->played_rows, y);
+
+	return TRUE;
+	}
+
+
+static void count_hint_cases(Minesweeper const *object, zuint *counts)
+	{
+	MinesweeperCell const *cell;
+	zsint near_offsets[8];
+	zuint y;
+
+	set_near_offsets(object, near_offsets);
+	counts[0] = 0;
+	counts[1] = 0;
+	counts[2] = 0;
+
+	for (y = object->size.y; y--;)
+		for (cell = ROW_END(y); cell-- != ROW(y);)
+			if (!(*cell & (DISCLOSED | FLAG | MINE)))
+				{
+				counts[2]++;
+
+				if (*cell & WARNING)
+					{
+					counts[1]++;
+					if (has_disclosed_neighbour(cell, near_offsets)) counts[0]++;
+					}
+				}
+	}
+
+
+static Z2DUInt case0_hint(Minesweeper const *object, zuint index)
+	{
+	MinesweeperCell const *cell;
+	zsint near_offsets[8];
+	zuint y;
+
+	set_near_offsets(object, near_offsets);
+
+	for (y = object->size.y; y--;)
+		for (cell = ROW_END(y); cell-- != ROW(y);) if (
+			!(*cell & (DISCLOSED | FLAG | MINE)) && (*cell & WARNING) &&
+			has_disclosed_neighbour(cell, near_offsets) && !index--
+		)
+			return z_2d_type(UINT)((zuint)(cell - ROW(y)), y);
 
 	return z_2d_type_zero(UINT);
 	}
@@ -186,11 +727,13 @@ static Z2DUInt case0_hint(Minesweeper const *object, zuint index)
 
 static Z2DUInt case1_hint(Minesweeper const *object, zuint index)
 	{
-	MinesweeperCell const *cell = MATRIX_END;
+	MinesweeperCell const *cell;
+	zuint y;
 
-	while (cell-- != object->matrix)
-		if (!(*cell & (DISCLOSED | FLAG | MINE)) && (*cell & WARNING) && !index--)
-			return z_2d_type(UINT)(X(cell), Y(cell));
+	for (y = object->size.y; y--;)
+		for (cell = ROW_END(y); cell-- != ROW(y);)
+			if (!(*cell & (DISCLOSED | FLAG | MINE)) && (*cell & WARNING) && !index--)
+				return z_2d_type(UINT)((zuint)(cell - ROW(y)), y);
 
 	return z_2d_type_zero(UINT);
 	}
@@ -198,35 +741,177 @@ static Z2DUInt case1_hint(Minesweeper const *object, zuint index)
 
 static Z2DUInt case2_hint(Minesweeper const *object, zuint index)
 	{
-	MinesweeperCell const *cell = MATRIX_END;
+	MinesweeperCell const *cell;
+	zuint y;
 
-	while (cell-- != object->matrix)
-		if (!(*cell & (DISCLOSED | FLAG | MINE)) && !index--)
-			return z_2d_type(UINT)(X(cell), Y(cell));
+	for (y = object->size.y; y--;)
+		for (cell = ROW_END(y); cell-- != ROW(y);)
+			if (!(*cell & (DISCLOSED | FLAG | MINE)) && !index--)
+				return z_2d_type(UINT)((zuint)(cell - ROW(y)), y);
 
 	return z_2d_type_zero(UINT);
 	}
 
 
+/*------------------------------------------------------------------------.
+| The block holds, in this order: the padded matrix, the mines still to   |
+| be placed in each block of rows, the two row bitmaps and the bitmap of  |
+| materialized blocks. The openings index, which is only needed by some	  |
+| functions, is allocated apart when it is built.			  |
+'------------------------------------------------------------------------*/
+static ZStatus resize_matrix(Minesweeper *object, Z2DUInt size)
+	{
+	zuint stride, bitmap_size = ROW_BITMAP_SIZE(size.y);
+	zusize padded_count, block_size;
+	zuint8 *block;
+
+	if (	size.x > Z_UINT_MAXIMUM - STRIDE_ALIGNMENT ||
+		(Z_USIZE_MAXIMUM - STRIDE_ALIGNMENT - BLOCK_MINES_SIZE(size.y) - bitmap_size * 2 -
+		 BLOCK_BITMAP_SIZE(size.y))
+		/ (stride = STRIDE(size.x)) < (zusize)size.y + 2
+	)
+		return Z_ERROR_TOO_BIG;
+
+	padded_count = PADDED_COUNT(stride, size.y);
+	block_size   = BLOCK_SIZE(stride, size.y);
+
+	if (	object->matrix == NULL ||
+		BLOCK_SIZE(object->stride, object->size.y) != block_size
+	)
+		{
+		if ((block = z_reallocate
+			(object->matrix == NULL ? NULL : BLOCK, block_size)
+		) == NULL)
+			return Z_ERROR_NOT_ENOUGH_MEMORY;
+		}
+
+	else block = BLOCK;
+
+	if (	object->openings != NULL &&
+		(object->size.x != size.x || object->size.y != size.y)
+	)
+		{
+		z_deallocate(object->openings);
+		object->openings = NULL;
+		}
+
+	object->stride	    = stride;
+	object->matrix	    = block + STRIDE_ALIGNMENT + stride;
+	object->block_mines = (zuint *)(block + padded_count);
+	object->dirty_rows  = block + padded_count + BLOCK_MINES_SIZE(size.y);
+	object->played_rows = object->dirty_rows + bitmap_size;
+	object->materialized_blocks = object->played_rows + bitmap_size;
+	return Z_OK;
+	}
+
+
+/*-------------------------------------------------------------------.
+| Resets the whole block: sentinels, empty cells and clean bitmaps.  |
+'-------------------------------------------------------------------*/
+static void reset_matrix(Minesweeper *object)
+	{
+	zuint y;
+
+	z_block_int8_set(BLOCK, PADDED_COUNT(object->stride, object->size.y), SENTINEL);
+	for (y = object->size.y; y--;) z_block_int8_set(ROW(y), object->size.x, 0);
+	z_block_int8_set
+		(object->block_mines,
+		 BLOCK_MINES_SIZE(object->size.y) + ROW_BITMAP_SIZE(object->size.y) * 2 +
+		 BLOCK_BITMAP_SIZE(object->size.y), 0);
+	}
+
+
+static void clear_rows(Minesweeper *object, zuint8 cell_mask)
+	{
+	zuint8 *dirty = object->dirty_rows, *played = object->played_rows, rows;
+	MinesweeperCell *cell, *row_end;
+	zuint index, row, y, bitmap_size = ROW_BITMAP_SIZE(object->size.y);
+
+	/*-------------------------------------------------------------------.
+	| The bitmaps are indexed by padded row (the sentinel row above the  |
+	| matrix is row 0). A zero mask resets the whole row, sentinels      |
+	| included, so the rows with mines or warnings must be visited too.  |
+	'-------------------------------------------------------------------*/
+	for (index = 0; index < bitmap_size; index++)
+		if ((rows = cell_mask ? played[index] : dirty[index] | played[index]))
+			for (	row = index * 8; rows && row < object->size.y + 2;
+				rows >>= 1, row++
+			)
+				if (rows & 1)
+					{
+					y    = row - 1;
+					cell = BLOCK + STRIDE_ALIGNMENT + (zusize)row * object->stride;
+
+					if (!cell_mask)
+						{
+						z_block_int8_set(cell - 1, object->stride + 1, SENTINEL);
+
+						if (row && row <= object->size.y)
+							z_block_int8_set(cell, object->size.x, 0);
+						}
+
+					else if (row && row <= object->size.y)
+						for (row_end = ROW_END(y); cell != row_end; cell++)
+							if (*cell & ~cell_mask)
+								{
+								*cell &= cell_mask;
+
+#								ifdef MINESWEEPER_USE_CALLBACK
+									if (object->cell_updated != NULL) UPDATED
+										(z_2d_type(UINT)((zuint)(cell - ROW(y)), y),
+										 *cell);
+#								endif
+								}
+					}
+
+	if (!cell_mask) z_block_int8_set(dirty, bitmap_size, 0);
+	z_block_int8_set(played, bitmap_size, 0);
+	}
+
+
 MINESWEEPER_API
 void minesweeper_initialize(Minesweeper *object)
 	{
-	object->state	   = MINESWEEPER_STATE_INITIALIZED;
-	object->size.x	   = 0;
-	object->size.y	   = 0;
-	object->mine_count = 0;
-	object->matrix	   = NULL;
+	object->state	    = MINESWEEPER_STATE_INITIALIZED;
+	object->size.x	    = 0;
+	object->size.y	    = 0;
+	object->stride	    = 0;
+	object->mine_count  = 0;
+	object->matrix	    = NULL;
+	object->dirty_rows  = NULL;
+	object->played_rows = NULL;
+	object->openings    = NULL;
+	object->zero_count    = 0;
+	object->opening_count = 0;
+	object->bbbv	      = 0;
+	object->lazy_warnings = FALSE;
+	object->materialized_blocks = NULL;
+	object->block_mines = NULL;
 
 #	ifdef MINESWEEPER_USE_CALLBACK
 		object->cell_updated	     = NULL;
 		object->cell_updated_context = NULL;
 #	endif
+
+#	ifdef MINESWEEPER_USE_LAYOUT_SOURCE
+		object->layout_source	      = NULL;
+		object->layout_source_context = NULL;
+		object->layout_mines	      = NULL;
+		object->layout_capacity	      = 0;
+#	endif
 	}
 
 
 MINESWEEPER_API
 void minesweeper_finalize(Minesweeper *object)
-	{z_deallocate(object->matrix);}
+	{
+	if (object->matrix   != NULL) z_deallocate(BLOCK);
+	if (object->openings != NULL) z_deallocate(object->openings);
+
+#	ifdef MINESWEEPER_USE_LAYOUT_SOURCE
+		if (object->layout_mines != NULL) z_deallocate(object->layout_mines);
+#	endif
+	}
 
 
 MINESWEEPER_API
@@ -245,16 +930,38 @@ ZStatus minesweeper_prepare(Minesweeper *object, Z2DUInt size, zuint mine_count)
 	)
 		return Z_ERROR_INVALID_ARGUMENT;
 
-	if (object->size.x * object->size.y != cell_count)
+	/*------------------------------------------------------------.
+	| Same geometry: only the rows written during the last game   |
+	| need to be cleared, the rest of the matrix is already zero. |
+	| The mines drawn for the blocks never read are dropped.      |
+	'------------------------------------------------------------*/
+	if (object->size.x == size.x && object->size.y == size.y)
 		{
-		void *matrix = z_reallocate(object->matrix, cell_count);
+		clear_rows(object, 0);
+		z_block_int8_set(object->block_mines, BLOCK_MINES_SIZE(size.y), 0);
+		}
+
+	else	{
+		ZStatus status = resize_matrix(object, size);
 
-		if (matrix == NULL) return Z_ERROR_NOT_ENOUGH_MEMORY;
-		object->matrix = matrix;
+		if (status) return status;
+		object->size = size;
+		reset_matrix(object);
 		}
 
-	z_block_int8_set(object->matrix, cell_count, 0);
-	object->size		= size;
+#	ifdef MINESWEEPER_USE_LAYOUT_SOURCE
+		if (object->layout_source != NULL && mine_count > object->layout_capacity)
+			{
+			zuint *mines = z_reallocate(object->layout_mines, (zusize)mine_count * sizeof(zuint));
+
+			if (mines != NULL)
+				{
+				object->layout_mines	= mines;
+				object->layout_capacity = mine_count;
+				}
+			}
+#	endif
+
 	object->state		= MINESWEEPER_STATE_PRISTINE;
 	object->flag_count	= 0;
 	object->mine_count	= mine_count;
@@ -263,6 +970,59 @@ ZStatus minesweeper_prepare(Minesweeper *object, Z2DUInt size, zuint mine_count)
 	}
 
 
+MINESWEEPER_API
+void minesweeper_restart(Minesweeper *object)
+	{
+	if (object->state == MINESWEEPER_STATE_INITIALIZED) return;
+	clear_rows(object, MINE | WARNING);
+	if (object->state > MINESWEEPER_STATE_PRISTINE) object->state = MINESWEEPER_STATE_PLAYING;
+	object->flag_count	= 0;
+	object->remaining_count = object->size.x * object->size.y - object->mine_count;
+	}
+
+
+MINESWEEPER_API
+void minesweeper_set_lazy_warnings(Minesweeper *object, zboolean value)
+	{object->lazy_warnings = value;}
+
+
+/*------------------------------------------------------------------.
+| The warnings are a cache of the mines, so computing them does not |
+| change the observable state of a const object. Neither does	    |
+| placing the mines already drawn for a block when it is read.	    |
+'------------------------------------------------------------------*/
+MINESWEEPER_API
+MinesweeperCell minesweeper_cell(Minesweeper const *object, Z2DUInt coordinates)
+	{
+	zuint block = coordinates.y / WARNING_BLOCK_ROWS;
+
+	if (!MATERIALIZED(block)) materialize_block((Minesweeper *)object, block);
+	return CELL(coordinates.x, coordinates.y);
+	}
+
+
+MINESWEEPER_API
+void minesweeper_export_matrix(Minesweeper const *object, MinesweeperCell *output)
+	{
+	zuint y;
+
+	materialize_warnings((Minesweeper *)object);
+
+	for (y = 0; y < object->size.y; y++, output += object->size.x)
+		z_copy(ROW(y), object->size.x, output);
+	}
+
+
+MINESWEEPER_API
+zuint minesweeper_opening_count(Minesweeper const *object)
+	{return index_openings((Minesweeper *)object) ? object->opening_count : 0;}
+
+
+MINESWEEPER_API
+zuint minesweeper_3bv(Minesweeper const *object)
+	{return index_openings((Minesweeper *)object) ? object->bbbv : 0;}
+
+
 MINESWEEPER_API
 zuint minesweeper_covered_count(Minesweeper const *object)
 	{return object->size.x * object->size.y - minesweeper_disclosed_count(object);}
@@ -282,17 +1042,20 @@ MinesweeperResult minesweeper_disclose(Minesweeper *object, Z2DUInt coordinates)
 	MinesweeperCell *cell = &CELL(coordinates.x, coordinates.y);
 
 	if (object->state == MINESWEEPER_STATE_PRISTINE) place_mines(object, coordinates);
+	MATERIALIZE(coordinates.y);
 	if (*cell & DISCLOSED) return MINESWEEPER_RESULT_ALREADY_DISCLOSED;
 	if (*cell & FLAG     ) return MINESWEEPER_RESULT_IS_FLAG;
 
 	if (*cell & MINE)
 		{
 		*cell |= DISCLOSED | EXPLODED;
+		MARK_ROW(object->played_rows, coordinates.y);
 		object->state = MINESWEEPER_STATE_EXPLODED;
 		return MINESWEEPER_RESULT_MINE_FOUND;
 		}
 
-	disclose_cell(object, coordinates);
+	if ((*cell & WARNING) || !object->bbbv || !disclose_opening(object, cell))
+		flood_fill(object, cell, coordinates.y);
 
 	if (!object->remaining_count)
 		{
@@ -314,6 +1077,7 @@ MinesweeperResult minesweeper_toggle_flag(
 	MinesweeperCell *cell = &CELL(coordinates.x, coordinates.y);
 
 	if (*cell & DISCLOSED) return MINESWEEPER_RESULT_ALREADY_DISCLOSED;
+	MATERIALIZE(coordinates.y);
 
 	if (*cell & FLAG)
 		{
@@ -324,6 +1088,7 @@ MinesweeperResult minesweeper_toggle_flag(
 	else	{
 		object->flag_count++;
 		*cell |= FLAG;
+		MARK_ROW(object->played_rows, coordinates.y);
 		}
 
 #	ifdef MINESWEEPER_USE_CALLBACK
@@ -338,52 +1103,44 @@ MinesweeperResult minesweeper_toggle_flag(
 MINESWEEPER_API
 void minesweeper_disclose_all_mines(Minesweeper *object)
 	{
-	MinesweeperCell *cell = MATRIX_END;
+	MinesweeperCell *cell;
+	zuint y;
 
-#	ifdef MINESWEEPER_USE_CALLBACK
-		if (object->cell_updated != NULL)
+	materialize_warnings(object);
+	z_block_int8_set(object->played_rows, ROW_BITMAP_SIZE(object->size.y), 0xFF);
+
+	for (y = object->size.y; y--;)
+		for (cell = ROW_END(y); cell-- != ROW(y);) if (*cell & MINE)
 			{
-			Z2DUInt point;
+			*cell |= DISCLOSED;
 
-			for (point.x = object->size.x; point.x--;)
-				for (point.y = object->size.y; point.y--;)
-					if (*--cell & MINE)
-						{
-						*cell |= DISCLOSED;
-						UPDATED(point, *cell);
-						}
+#			ifdef MINESWEEPER_USE_CALLBACK
+				if (object->cell_updated != NULL)
+					UPDATED(z_2d_type(UINT)((zuint)(cell - ROW(y)), y), *cell);
+#			endif
 			}
-
-		else
-#	endif
-
-	while (cell != object->matrix) if (*--cell & MINE) *cell |= DISCLOSED;
 	}
 
 
 MINESWEEPER_API
 void minesweeper_flag_all_mines(Minesweeper *object)
 	{
-	MinesweeperCell *cell = MATRIX_END;
+	MinesweeperCell *cell;
+	zuint y;
 
-#	ifdef MINESWEEPER_USE_CALLBACK
-		if (object->cell_updated != NULL)
+	materialize_warnings(object);
+	z_block_int8_set(object->played_rows, ROW_BITMAP_SIZE(object->size.y), 0xFF);
+
+	for (y = object->size.y; y--;)
+		for (cell = ROW_END(y); cell-- != ROW(y);) if (*cell & MINE)
 			{
-			Z2DUInt point;
+			*cell |= FLAG;
 
-			for (point.x = object->size.x; point.x--;)
-				for (point.y = object->size.y; point.y--;)
-					if (*--cell & MINE)
-						{
-						*cell |= FLAG;
-						UPDATED(point, *cell);
-						}
+#			ifdef MINESWEEPER_USE_CALLBACK
+				if (object->cell_updated != NULL)
+					UPDATED(z_2d_type(UINT)((zuint)(cell - ROW(y)), y), *cell);
+#			endif
 			}
-
-		else
-#	endif
-
-	while (cell != object->matrix) if (*--cell & MINE) *cell |= FLAG;
 	}
 
 
@@ -406,6 +1163,7 @@ zboolean minesweeper_hint(Minesweeper *object, Z2DUInt *coordinates)
 		return TRUE;
 		}
 
+	materialize_warnings(object);
 	count_hint_cases(object, counts);
 	if	(counts[0]) *coordinates = case0_hint(object, RANDOM % counts[0]);
 	else if (counts[1]) *coordinates = case1_hint(object, RANDOM % counts[1]);
@@ -418,26 +1176,23 @@ zboolean minesweeper_hint(Minesweeper *object, Z2DUInt *coordinates)
 MINESWEEPER_API
 void minesweeper_resolve(Minesweeper *object)
 	{
-	MinesweeperCell *cell = MATRIX_END;
+	MinesweeperCell *cell;
+	zuint y;
 
-#	ifdef MINESWEEPER_USE_CALLBACK
-		if (object->cell_updated != NULL)
+	materialize_warnings(object);
+	z_block_int8_set(object->played_rows, ROW_BITMAP_SIZE(object->size.y), 0xFF);
+
+	for (y = object->size.y; y--;)
+		for (cell = ROW_END(y); cell-- != ROW(y);) if (!(*cell & (MINE | DISCLOSED)))
 			{
-			Z2DUInt point;
+			*cell |= DISCLOSED;
 
-			for (point.x = object->size.x; point.x--;)
-				for (point.y = object->size.y; point.y--;)
-					if (!(*--cell & (MINE | DISCLOSED)))
-						{
-						*cell |= DISCLOSED;
-						UPDATED(point, *cell);
-						}
+#			ifdef MINESWEEPER_USE_CALLBACK
+				if (object->cell_updated != NULL)
+					UPDATED(z_2d_type(UINT)((zuint)(cell - ROW(y)), y), *cell);
+#			endif
 			}
 
-		else
-#	endif
-
-	while (cell != object->matrix) if (!(*--cell & (MINE | DISCLOSED))) *cell |= DISCLOSED;
 	object->remaining_count = 0;
 	}
 
@@ -460,8 +1215,7 @@ void minesweeper_snapshot(Minesweeper const *object, void *output)
 	HEADER(output)->state	   = object->state;
 
 	if (object->state > MINESWEEPER_STATE_PRISTINE)
-		z_copy	(object->matrix, object->size.x * object->size.y,
-			 (zuint8 *)output + HEADER_SIZE);
+		minesweeper_export_matrix(object, (zuint8 *)output + HEADER_SIZE);
 	}
 
 
@@ -470,7 +1224,7 @@ ZStatus minesweeper_set_snapshot(Minesweeper *object, void *snapshot, zusize sna
 	{
 	MinesweeperCell *cell, *matrix;
 	Z2DUInt size;
-	zuint cell_count;
+	zuint cell_count, y;
 	ZStatus status = minesweeper_snapshot_test(snapshot, snapshot_size);
 
 	if (status) return status;
@@ -479,37 +1233,36 @@ ZStatus minesweeper_set_snapshot(Minesweeper *object, void *snapshot, zusize sna
 		((zuint)z_uint64_big_endian(HEADER(snapshot)->x),
 		 (zuint)z_uint64_big_endian(HEADER(snapshot)->y));
 
-	cell_count = size.x * size.y;
-
-	if (cell_count != object->size.x * object->size.y)
-		{
-		if ((matrix = z_reallocate(object->matrix, cell_count)) == NULL)
-			return Z_ERROR_NOT_ENOUGH_MEMORY;
-
-		object->matrix = matrix;
-		}
-
-	else matrix = object->matrix;
+	if ((status = resize_matrix(object, size))) return status;
 
+	cell_count		= size.x * size.y;
 	object->size		= size;
 	object->mine_count	= (zuint)z_uint64_big_endian(HEADER(snapshot)->mine_count);
 	object->state		= HEADER(snapshot)->state;
 	object->flag_count	= 0;
 	object->remaining_count = cell_count - object->mine_count;
+	reset_matrix(object);
 
-	if (object->state <= MINESWEEPER_STATE_PRISTINE)
-		z_block_int8_set(matrix, cell_count, 0);
+	if (object->state > MINESWEEPER_STATE_PRISTINE)
+		{
+		matrix = (MinesweeperCell *)snapshot + HEADER_SIZE;
 
-	else	{
-		z_copy((zuint8 *)snapshot + HEADER_SIZE, cell_count, matrix);
+		for (y = 0; y < size.y; y++, matrix += size.x)
+			z_copy(matrix, size.x, ROW(y));
 
-		for (cell = matrix + cell_count; cell-- != matrix;)
+		for (matrix -= cell_count, cell = matrix + cell_count; cell-- != matrix;)
 			{
 			if (*cell & FLAG) object->flag_count++;
 			if ((*cell & DISCLOSED) && !(*cell & MINE)) object->remaining_count--;
 			}
+
+		z_block_int8_set
+			(object->dirty_rows,
+			 ROW_BITMAP_SIZE(size.y) * 2 + BLOCK_BITMAP_SIZE(size.y), 0xFF);
 		}
 
+	object->bbbv = 0;
+
 	return Z_OK;
 	}
 
@@ -530,10 +1283,47 @@ ZStatus minesweeper_set_snapshot(Minesweeper *object, void *snapshot, zusize sna
 #endif
 
 
+#ifdef MINESWEEPER_USE_LAYOUT_SOURCE
+
+	MINESWEEPER_API
+	void minesweeper_set_layout_source(
+		Minesweeper* object,
+		void*	     layout_source,
+		void*	     layout_source_context
+	)
+		{
+		object->layout_source	      = layout_source;
+		object->layout_source_context = layout_source_context;
+		}
+
+#endif
+
+
+static zuint8 local_warning(
+	MinesweeperCell const* matrix,
+	Z2DUInt		       size,
+	zuint		       x,
+	zuint		       y
+)
+	{
+	Z2DSInt8 const *offset;
+	zuint near_x, near_y;
+	zuint8 warning = 0;
+
+	for (offset = offsets + 8; offset-- != offsets;) if (
+		VALID_LOCAL(near_x = x + offset->x, near_y = y + offset->y) &&
+		(CELL_LOCAL(near_x, near_y) & MINE)
+	)
+		warning++;
+
+	return warning;
+	}
+
+
 MINESWEEPER_API
 ZStatus minesweeper_snapshot_test(void const *snapshot, zusize snapshot_size)
 	{
-	Z2DUInt64	 size;
+	Z2DUInt64	 size64;
 	zuint64		 mine_count;
 	MinesweeperState state;
 	zuint		 cell_count;
@@ -546,9 +1336,9 @@ ZStatus minesweeper_snapshot_test(void const *snapshot, zusize snapshot_size)
 
 	if (	state == MINESWEEPER_STATE_INITIALIZED				 ||
 		state >  MINESWEEPER_STATE_SOLVED				 ||
-		(size.x = z_uint64_big_endian(HEADER(snapshot)->x))		 <
+		(size64.x = z_uint64_big_endian(HEADER(snapshot)->x))		 <
 		MINESWEEPER_MINIMUM_X_SIZE					 ||
-		(size.y = z_uint64_big_endian(HEADER(snapshot)->y))		 <
+		(size64.y = z_uint64_big_endian(HEADER(snapshot)->y))		 <
 		MINESWEEPER_MINIMUM_Y_SIZE					 ||
 		(mine_count = z_uint64_big_endian(HEADER(snapshot)->mine_count)) <
 		MINESWEEPER_MINIMUM_MINE_COUNT
@@ -557,21 +1347,21 @@ ZStatus minesweeper_snapshot_test(void const *snapshot, zusize snapshot_size)
 
 	if (
 #		if Z_UINT_BITS < 64
-			size.x > Z_UINT_MAXIMUM || size.y > Z_UINT_MAXIMUM ||
+			size64.x > Z_UINT_MAXIMUM || size64.y > Z_UINT_MAXIMUM ||
 #		endif
-		z_type_multiplication_overflows(UINT)((zuint)size.x, (zuint)size.y)
+		z_type_multiplication_overflows(UINT)((zuint)size64.x, (zuint)size64.y)
 	)
 		return Z_ERROR_TOO_BIG;
 
-	if (mine_count > (cell_count = (zuint)size.x * (zuint)size.y) - 1)
+	if (mine_count > (cell_count = (zuint)size64.x * (zuint)size64.y) - 1)
 		return Z_ERROR_INVALID_VALUE;
 
 	if (state != MINESWEEPER_STATE_PRISTINE)
 		{
-		MinesweeperCell const *matrix = Z_BOP(void *, snapshot, HEADER_SIZE), *cell;
-		Z2DSInt8 const *offset;
-		zuint real_mine_count, exploded_count, x, y, near_x, near_y;
-		zuint8 warning;
+		MinesweeperCell const *matrix = Z_BOP(void *, snapshot, HEADER_SIZE), *cell, *row_end;
+		Z2DUInt size = z_2d_type(UINT)((zuint)size64.x, (zuint)size64.y);
+		zsint stride = (zsint)size.x;
+		zuint real_mine_count, exploded_count, x, y;
 
 		if (snapshot_size != HEADER_SIZE + cell_count) return Z_ERROR_INVALID_SIZE;
 
@@ -591,48 +1381,40 @@ ZStatus minesweeper_snapshot_test(void const *snapshot, zusize snapshot_size)
 			)
 				return Z_ERROR_INVALID_DATA;
 
-			/*------------------------------------------.
-			| The mines must be surrounded by warnings. |
-			'------------------------------------------*/
-			if (*cell & MINE)
-				{
-				real_mine_count++;
+			if (*cell & MINE) real_mine_count++;
+			}
 
-				x = (zuint)(cell - matrix) % size.x;
-				y = (zuint)(cell - matrix) / size.x;
+		if (mine_count != real_mine_count) return Z_ERROR_INVALID_DATA;
 
-				for (offset = offsets + 8; offset-- != offsets;) if (
-					VALID_LOCAL
-						(near_x = x + offset->x,
-						 near_y = y + offset->y)
-					&& !(CELL_LOCAL(near_x, near_y) & WARNING)
-				)
+		/*------------------------------------------------------------.
+		| The warning number of every cell must match the amount of   |
+		| surrounding mines, which also ensures that the mines are    |
+		| surrounded by warnings. The inner cells are checked through |
+		| fixed offsets and only the border cells need bounds checks. |
+		'------------------------------------------------------------*/
+		for (y = 1; y < size.y - 1; y++)
+			for (	cell = &CELL_LOCAL(1, y), row_end = cell + size.x - 2;
+				cell != row_end; cell++
+			)
+				if ((zuint)(*cell & WARNING) != (zuint)(
+					(cell[-stride - 1] & MINE) + (cell[-stride] & MINE) +
+					(cell[-stride + 1] & MINE) + (cell[-1]	    & MINE) +
+					(cell[1]	   & MINE) + (cell[stride - 1] & MINE) +
+					(cell[stride]	   & MINE) + (cell[stride + 1] & MINE)
+				) / MINE)
 					return Z_ERROR_INVALID_DATA;
-				}
 
-			/*---------------------------------------.
-			| The warning numbers must be surrounded |
-			| by the correct amount of mines.	 |
-			'---------------------------------------*/
-			if (*cell & WARNING)
-				{
-				x = (zuint)(cell - matrix) % size.x;
-				y = (zuint)(cell - matrix) / size.x;
-				warning = 0;
-
-				for (offset = offsets + 8; offset-- != offsets;) if (
-					VALID_LOCAL
-						(near_x = x + offset->x,
-						 near_y = y + offset->y)
-					&& (CELL_LOCAL(near_x, near_y) & MINE)
-				)
-					warning++;
-
-				if (warning != (*cell & WARNING)) return Z_ERROR_INVALID_DATA;
-				}
-			}
-
-		if (mine_count != real_mine_count) return Z_ERROR_INVALID_DATA;
+		for (x = 0; x < size.x; x++) if (
+			(CELL_LOCAL(x, 0)	   & WARNING) != local_warning(matrix, size, x, 0) ||
+			(CELL_LOCAL(x, size.y - 1) & WARNING) != local_warning(matrix, size, x, size.y - 1)
+		)
+			return Z_ERROR_INVALID_DATA;
+
+		for (y = 1; y < size.y - 1; y++) if (
+			(CELL_LOCAL(0, y)	   & WARNING) != local_warning(matrix, size, 0, y) ||
+			(CELL_LOCAL(size.x - 1, y) & WARNING) != local_warning(matrix, size, size.x - 1, y)
+		)
+			return Z_ERROR_INVALID_DATA;
 		}
 
 	return Z_OK;
@@ -0,0 +1,681 @@
+/* Minesweeper Kit - MinesweeperDaemon.c
+   __  __
+  /  \/  \  __ ___  ____   ______ __ ______ ____ ____  ____ ____
+ /	  \(__)   \/  -_)_/  _/  /  / /  -_)  -_)  _ \/  -_)  _/
+/___/__/__/__/__/_/\___/____/ |______/\___/\___/  ___/\___/__/
+(C) 2012-2018 Manuel Sainz de Baranda y Goñi. /__/
+Released under the terms of the GNU Lesser General Public License v3.
+
+Reference game server. It hosts many games behind one epoll loop per shard
+(thread), on a TCP port of the loopback interface or on a Unix socket, and
+speaks the protocol defined in MinesweeperProtocol.h. All the requests
+available in the input buffer of a connection are processed before its
+responses are written with a single call, and the disclosed cells are sent
+as lists of changed cells collected through the cell updated callback, so
+the library must be built with MINESWEEPER_USE_CALLBACK. With `-g`, the
+mines of the classic configurations are placed in advance by the threads of
+a MinesweeperGenerator. */
+
+#define _GNU_SOURCE
+
+#include <Z/functions/base/Z2D.h>
+#include "MinesweeperProtocol.h"
+#include "MinesweeperGenerator.h"
+
+#ifndef MINESWEEPER_USE_CALLBACK
+#	error "The daemon requires MINESWEEPER_USE_CALLBACK"
+#endif
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define EVENT_COUNT	       256
+#define READ_SIZE	       65536
+#define OUTPUT_HIGH_WATER_MARK (4 * 1024 * 1024)
+#define REQUEST_SIZE	       ((zusize)sizeof(MinesweeperProtocolRequest))
+#define RESPONSE_SIZE	       ((zusize)sizeof(MinesweeperProtocolResponse))
+#define GENERATOR_QUEUE_SIZE   1024
+
+typedef struct {
+	zuint8* data;
+	zusize	size;
+	zusize	capacity;
+} Buffer;
+
+typedef struct {
+	int	 fd;
+	zuint32	 events;
+	Buffer	 input;
+	Buffer	 output;
+	zusize	 output_sent;
+	zboolean failed;
+	zboolean finished;
+	zuint32* games;
+	zuint	 game_count;
+	zuint	 game_capacity;
+} Connection;
+
+/*----------------------------------------------------------------------.
+| A game belongs to the connection that created it: the other ones see  |
+| its identifier as unknown, and it is destroyed when the owner closes. |
+'----------------------------------------------------------------------*/
+typedef struct {
+	Minesweeper* game;
+	Connection*  owner;
+} GameSlot;
+
+typedef struct {
+	pthread_t thread;
+	int	  epoll;
+	int	  listener;
+	GameSlot* games;
+	zuint	  game_capacity;
+	zuint*	  free_games;
+	zuint	  free_game_count;
+} Shard;
+
+static MinesweeperGeneratorConfiguration const configurations[] = {
+	{{ 9,  9}, 10},
+	{{16, 16}, 40},
+	{{30, 16}, 99}
+};
+
+static MinesweeperGenerator generator;
+static zboolean		    generator_running = FALSE;
+
+
+static zboolean buffer_reserve(Buffer *buffer, zusize size)
+	{
+	if (buffer->capacity - buffer->size < size)
+		{
+		zusize capacity = buffer->capacity ? buffer->capacity : 4096;
+		void *data;
+
+		while (capacity - buffer->size < size) capacity *= 2;
+		if ((data = realloc(buffer->data, capacity)) == NULL) return FALSE;
+		buffer->data	 = data;
+		buffer->capacity = capacity;
+		}
+
+	return TRUE;
+	}
+
+
+/*------------------------------------------------------------------------.
+| Called by the library for every cell changed by the current command;	  |
+| the cells are appended to the payload of the response being built.	  |
+'------------------------------------------------------------------------*/
+static void cell_updated(
+	void*		   context,
+	Minesweeper const* game,
+	Z2DUInt		   point,
+	MinesweeperCell	   cell
+)
+	{
+	Connection *connection = context;
+	MinesweeperProtocolCell *entry;
+
+	(void)game;
+
+	if (!buffer_reserve(&connection->output, sizeof(MinesweeperProtocolCell)))
+		{
+		connection->failed = TRUE;
+		return;
+		}
+
+	entry = (MinesweeperProtocolCell *)(connection->output.data + connection->output.size);
+	entry->x    = htonl(point.x);
+	entry->y    = htonl(point.y);
+	entry->cell = cell;
+	connection->output.size += sizeof(MinesweeperProtocolCell);
+	}
+
+
+static Minesweeper *shard_game(Shard *shard, Connection *connection, zuint32 id)
+	{
+	return	id && id <= shard->game_capacity && shard->games[id - 1].owner == connection
+		? shard->games[id - 1].game : NULL;
+	}
+
+
+static zuint32 shard_create_game(Shard *shard, Connection *connection)
+	{
+	Minesweeper *game;
+	zuint index;
+
+	if (connection->game_count == connection->game_capacity)
+		{
+		zuint capacity = connection->game_capacity ? connection->game_capacity * 2 : 4;
+		zuint32 *games;
+
+		if ((games = realloc(connection->games, capacity * sizeof(zuint32))) == NULL)
+			return 0;
+
+		connection->games	  = games;
+		connection->game_capacity = capacity;
+		}
+
+	if (!shard->free_game_count)
+		{
+		zuint capacity = shard->game_capacity ? shard->game_capacity * 2 : 64;
+		GameSlot *games;
+		zuint *free_games;
+
+		if ((games = realloc(shard->games, capacity * sizeof(GameSlot))) == NULL)
+			return 0;
+
+		shard->games = games;
+
+		if ((free_games = realloc(shard->free_games, capacity * sizeof(zuint))) == NULL)
+			return 0;
+
+		shard->free_games = free_games;
+
+		for (index = capacity; index-- != shard->game_capacity;)
+			{
+			games[index].game  = NULL;
+			games[index].owner = NULL;
+			free_games[shard->free_game_count++] = index;
+			}
+
+		shard->game_capacity = capacity;
+		}
+
+	if ((game = malloc(sizeof(Minesweeper))) == NULL) return 0;
+	minesweeper_initialize(game);
+
+	if (generator_running) minesweeper_set_layout_source
+		(game, (void *)minesweeper_generator_take, &generator);
+	index = shard->free_games[--shard->free_game_count];
+	shard->games[index].game  = game;
+	shard->games[index].owner = connection;
+	connection->games[connection->game_count++] = index + 1;
+	return index + 1;
+	}
+
+
+static void shard_destroy_game(Shard *shard, zuint32 id)
+	{
+	Connection *owner = shard->games[id - 1].owner;
+	zuint index = owner->game_count;
+
+	while (owner->games[--index] != id);
+	owner->games[index] = owner->games[--owner->game_count];
+	minesweeper_finalize(shard->games[id - 1].game);
+	free(shard->games[id - 1].game);
+	shard->games[id - 1].game  = NULL;
+	shard->games[id - 1].owner = NULL;
+	shard->free_games[shard->free_game_count++] = id - 1;
+	}
+
+
+static zboolean valid_point(Minesweeper const *game, Z2DUInt point)
+	{
+	return	game->state != MINESWEEPER_STATE_INITIALIZED &&
+		point.x < game->size.x && point.y < game->size.y;
+	}
+
+
+/*-----------------------------------------------------------------------.
+| Processes one request and appends its response to the output buffer.  |
+| The header is reserved first and completed once the payload is known. |
+'-----------------------------------------------------------------------*/
+static void process_request(
+	Shard*				  shard,
+	Connection*			  connection,
+	MinesweeperProtocolRequest const* request,
+	zuint8 const*			  payload
+)
+	{
+	MinesweeperProtocolResponse *response;
+	Minesweeper *game;
+	Z2DUInt point;
+	zusize header_offset, payload_offset;
+	zuint32 id = ntohl(request->game);
+	zuint16 payload_size = ntohs(request->payload_size);
+	zuint8 result = Z_OK;
+
+	if (!buffer_reserve(&connection->output, RESPONSE_SIZE))
+		{
+		connection->failed = TRUE;
+		return;
+		}
+
+	header_offset = connection->output.size;
+	payload_offset = connection->output.size += RESPONSE_SIZE;
+	game = shard_game(shard, connection, id);
+
+	if (request->command == MINESWEEPER_PROTOCOL_COMMAND_CREATE)
+		{
+		if (!(id = shard_create_game(shard, connection)))
+			result = MINESWEEPER_PROTOCOL_RESULT_NOT_ENOUGH_MEMORY;
+
+		else game = shard->games[id - 1].game;
+		}
+
+	else if (game == NULL) result = MINESWEEPER_PROTOCOL_RESULT_UNKNOWN_GAME;
+
+	else switch (request->command)
+		{
+		case MINESWEEPER_PROTOCOL_COMMAND_DESTROY:
+		shard_destroy_game(shard, id);
+		game = NULL;
+		break;
+
+		case MINESWEEPER_PROTOCOL_COMMAND_PREPARE:
+		if (payload_size != sizeof(MinesweeperProtocolPrepare))
+			result = MINESWEEPER_PROTOCOL_RESULT_BAD_REQUEST;
+
+		else	{
+			MinesweeperProtocolPrepare const *prepare =
+				(MinesweeperProtocolPrepare const *)payload;
+
+			switch (minesweeper_prepare(game, z_2d_type(UINT)
+				(ntohl(prepare->x), ntohl(prepare->y)),
+				 ntohl(prepare->mine_count))
+			)
+				{
+				case Z_OK: break;
+
+				case Z_ERROR_NOT_ENOUGH_MEMORY:
+				result = MINESWEEPER_PROTOCOL_RESULT_NOT_ENOUGH_MEMORY;
+				break;
+
+				default: result = MINESWEEPER_PROTOCOL_RESULT_INVALID_ARGUMENT;
+				}
+			}
+		break;
+
+		case MINESWEEPER_PROTOCOL_COMMAND_RESTART:
+		minesweeper_set_cell_updated_callback(game, (void *)cell_updated, connection);
+		minesweeper_restart(game);
+		break;
+
+		case MINESWEEPER_PROTOCOL_COMMAND_DISCLOSE:
+		case MINESWEEPER_PROTOCOL_COMMAND_TOGGLE_FLAG:
+		if (	payload_size != sizeof(MinesweeperProtocolPoint) ||
+			(point = z_2d_type(UINT)
+				(ntohl(((MinesweeperProtocolPoint const *)payload)->x),
+				 ntohl(((MinesweeperProtocolPoint const *)payload)->y)),
+			 !valid_point(game, point))
+		)
+			{
+			result = MINESWEEPER_PROTOCOL_RESULT_BAD_REQUEST;
+			break;
+			}
+
+		minesweeper_set_cell_updated_callback(game, (void *)cell_updated, connection);
+
+		if (request->command == MINESWEEPER_PROTOCOL_COMMAND_TOGGLE_FLAG)
+			result = minesweeper_toggle_flag(game, point, NULL);
+
+		/*------------------------------------------------------------.
+		| The exploded cell is not reported by the callback.	      |
+		'------------------------------------------------------------*/
+		else if ((result = minesweeper_disclose(game, point)) == MINESWEEPER_RESULT_MINE_FOUND)
+			cell_updated(connection, game, point, minesweeper_cell(game, point));
+		break;
+
+		case MINESWEEPER_PROTOCOL_COMMAND_HINT:
+		if (game->state == MINESWEEPER_STATE_INITIALIZED)
+			result = MINESWEEPER_PROTOCOL_RESULT_BAD_REQUEST;
+
+		else if ((result = minesweeper_hint(game, &point)))
+			cell_updated(connection, game, point, minesweeper_cell(game, point));
+		break;
+
+		case MINESWEEPER_PROTOCOL_COMMAND_SNAPSHOT:
+			{
+			zusize size = minesweeper_snapshot_size(game);
+
+			if (!buffer_reserve(&connection->output, size))
+				{
+				result = MINESWEEPER_PROTOCOL_RESULT_NOT_ENOUGH_MEMORY;
+				break;
+				}
+
+			minesweeper_snapshot(game, connection->output.data + connection->output.size);
+			connection->output.size += size;
+			}
+		break;
+
+		default: result = MINESWEEPER_PROTOCOL_RESULT_BAD_REQUEST;
+		}
+
+	if (game != NULL) minesweeper_set_cell_updated_callback(game, NULL, NULL);
+
+	/*-------------------------------------------------------------.
+	| The buffer may have been moved by the callback, so the       |
+	| header is addressed again from its offset.		       |
+	'-------------------------------------------------------------*/
+	response = (MinesweeperProtocolResponse *)(connection->output.data + header_offset);
+	response->game	       = htonl(id);
+	response->command      = request->command;
+	response->result       = result;
+	response->state	       = game != NULL ? game->state : MINESWEEPER_STATE_INITIALIZED;
+	response->reserved     = 0;
+	response->payload_size = htonl((zuint32)(connection->output.size - payload_offset));
+	}
+
+
+static void connection_close(Shard *shard, Connection *connection)
+	{
+	while (connection->game_count)
+		shard_destroy_game(shard, connection->games[connection->game_count - 1]);
+
+	epoll_ctl(shard->epoll, EPOLL_CTL_DEL, connection->fd, NULL);
+	close(connection->fd);
+	free(connection->games);
+	free(connection->input.data);
+	free(connection->output.data);
+	free(connection);
+	}
+
+
+static zboolean connection_flush(Shard *shard, Connection *connection)
+	{
+	struct epoll_event event;
+	zuint32 events;
+	ssize_t sent;
+
+	while (connection->output_sent < connection->output.size)
+		{
+		if ((sent = send(
+			connection->fd, connection->output.data + connection->output_sent,
+			connection->output.size - connection->output_sent, MSG_NOSIGNAL)
+		) < 0)
+			{
+			if (errno == EINTR) continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+			return FALSE;
+			}
+
+		connection->output_sent += (zusize)sent;
+		}
+
+	/*----------------------------------------------------------.
+	| Once the peer has finished sending, the connection is	    |
+	| closed as soon as all its responses have been sent.	    |
+	'----------------------------------------------------------*/
+	if (connection->output_sent == connection->output.size)
+		{
+		if (connection->finished) return FALSE;
+		connection->output.size = connection->output_sent = 0;
+		}
+
+	/*---------------------------------------------------------------.
+	| Wait for EPOLLOUT only while there is pending output, and stop |
+	| reading requests while the output is above the high mark or    |
+	| after the end of the input.                                    |
+	'---------------------------------------------------------------*/
+	events = connection->finished || connection->output.size > OUTPUT_HIGH_WATER_MARK ? 0 : EPOLLIN;
+	if (connection->output.size) events |= EPOLLOUT;
+
+	if (events != connection->events)
+		{
+		event.events   = connection->events = events;
+		event.data.ptr = connection;
+		if (epoll_ctl(shard->epoll, EPOLL_CTL_MOD, connection->fd, &event)) return FALSE;
+		}
+
+	return TRUE;
+	}
+
+
+static zboolean connection_read(Shard *shard, Connection *connection)
+	{
+	MinesweeperProtocolRequest const *request;
+	zusize offset, size;
+	ssize_t received;
+
+	for (;;)
+		{
+		if (!buffer_reserve(&connection->input, READ_SIZE)) return FALSE;
+
+		if ((received = recv(
+			connection->fd, connection->input.data + connection->input.size,
+			connection->input.capacity - connection->input.size, 0)
+		) < 0)
+			{
+			if (errno == EINTR) continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+			return FALSE;
+			}
+
+		/*------------------------------------------------------.
+		| At the end of the input the requests already received |
+		| are still processed and their responses sent.		|
+		'------------------------------------------------------*/
+		if (!received)
+			{
+			connection->finished = TRUE;
+			break;
+			}
+
+		connection->input.size += (zusize)received;
+		if (connection->input.size < connection->input.capacity) break;
+		}
+
+	for (offset = 0; connection->input.size - offset >= REQUEST_SIZE; offset += size)
+		{
+		request = (MinesweeperProtocolRequest const *)(connection->input.data + offset);
+
+		if (ntohs(request->payload_size) > MINESWEEPER_PROTOCOL_MAXIMUM_PAYLOAD_SIZE)
+			return FALSE;
+
+		if (connection->input.size - offset < (size = REQUEST_SIZE + ntohs(request->payload_size)))
+			break;
+
+		process_request(shard, connection, request, (zuint8 const *)(request + 1));
+		if (connection->failed) return FALSE;
+		}
+
+	if (offset)
+		{
+		memmove(connection->input.data, connection->input.data + offset,
+			connection->input.size -= offset);
+		}
+
+	return connection_flush(shard, connection);
+	}
+
+
+static void shard_accept(Shard *shard)
+	{
+	struct epoll_event event;
+	Connection *connection;
+	int fd, yes = 1;
+
+	while ((fd = accept4(shard->listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+		{
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+		if ((connection = calloc(1, sizeof(Connection))) == NULL)
+			{
+			close(fd);
+			continue;
+			}
+
+		connection->fd = fd;
+		event.events   = connection->events = EPOLLIN;
+		event.data.ptr = connection;
+
+		if (epoll_ctl(shard->epoll, EPOLL_CTL_ADD, fd, &event))
+			{
+			close(fd);
+			free(connection);
+			}
+		}
+	}
+
+
+static void *shard_run(void *context)
+	{
+	Shard *shard = context;
+	struct epoll_event events[EVENT_COUNT];
+	Connection *connection;
+	int count, index;
+
+	for (;;)
+		{
+		if ((count = epoll_wait(shard->epoll, events, EVENT_COUNT, -1)) < 0)
+			{
+			if (errno == EINTR) continue;
+			perror("epoll_wait");
+			break;
+			}
+
+		for (index = 0; index < count; index++)
+			{
+			if (events[index].data.ptr == NULL)
+				{
+				shard_accept(shard);
+				continue;
+				}
+
+			connection = events[index].data.ptr;
+
+			if (	(events[index].events & (EPOLLERR | EPOLLHUP) &&
+				 !(events[index].events & EPOLLIN))		       ||
+				((events[index].events & EPOLLOUT) && !connection_flush(shard, connection)) ||
+				((events[index].events & EPOLLIN ) && !connection_read (shard, connection))
+			)
+				connection_close(shard, connection);
+			}
+		}
+
+	return NULL;
+	}
+
+
+static int open_listener(char const *unix_path, int port)
+	{
+	int fd, yes = 1;
+
+	if (unix_path != NULL)
+		{
+		struct sockaddr_un address;
+
+		memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		strncpy(address.sun_path, unix_path, sizeof(address.sun_path) - 1);
+		unlink(unix_path);
+
+		if (	(fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0 ||
+			bind(fd, (struct sockaddr *)&address, sizeof(address))
+		)
+			return -1;
+		}
+
+	else	{
+		struct sockaddr_in address;
+
+		memset(&address, 0, sizeof(address));
+		address.sin_family	= AF_INET;
+		address.sin_port	= htons((zuint16)port);
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		if (	(fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0 ||
+			setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes))		 ||
+			bind(fd, (struct sockaddr *)&address, sizeof(address))
+		)
+			return -1;
+		}
+
+	return listen(fd, SOMAXCONN) ? -1 : fd;
+	}
+
+
+int main(int argc, char **argv)
+	{
+	struct epoll_event event;
+	char const *unix_path = NULL;
+	int port = MINESWEEPER_PROTOCOL_DEFAULT_PORT, shard_count = 1, generator_thread_count = 0;
+	int listener, option, index;
+	Shard *shards;
+
+	while ((option = getopt(argc, argv, "u:p:t:g:")) != -1) switch (option)
+		{
+		case 'u': unix_path		 = optarg;	 break;
+		case 'p': port			 = atoi(optarg); break;
+		case 't': shard_count		 = atoi(optarg); break;
+		case 'g': generator_thread_count = atoi(optarg); break;
+
+		default:
+		fprintf(stderr,
+			"usage: %s [-u unix_socket | -p port] [-t threads] [-g generator_threads]\n",
+			argv[0]);
+
+		return 1;
+		}
+
+	if (shard_count < 1) shard_count = 1;
+	signal(SIGPIPE, SIG_IGN);
+
+	if (generator_thread_count > 0)
+		{
+		if (minesweeper_generator_initialize(
+			&generator, configurations,
+			sizeof(configurations) / sizeof(*configurations),
+			GENERATOR_QUEUE_SIZE, (zuint)generator_thread_count)
+		)
+			{
+			fputs("cannot start the generator\n", stderr);
+			return 1;
+			}
+
+		generator_running = TRUE;
+		}
+
+	if ((listener = open_listener(unix_path, port)) < 0)
+		{
+		perror("listen");
+		return 1;
+		}
+
+	if ((shards = calloc((zusize)shard_count, sizeof(Shard))) == NULL) return 1;
+
+	/*-----------------------------------------------------------------.
+	| Every shard waits on the shared listener; EPOLLEXCLUSIVE wakes   |
+	| only one of them per incoming connection.			   |
+	'-----------------------------------------------------------------*/
+	for (index = 0; index < shard_count; index++)
+		{
+		shards[index].listener = listener;
+		event.events	       = EPOLLIN | EPOLLEXCLUSIVE;
+		event.data.ptr	       = NULL;
+
+		if (	(shards[index].epoll = epoll_create1(EPOLL_CLOEXEC)) < 0 ||
+			epoll_ctl(shards[index].epoll, EPOLL_CTL_ADD, listener, &event)
+		)
+			{
+			perror("epoll");
+			return 1;
+			}
+		}
+
+	for (index = 1; index < shard_count; index++)
+		if (pthread_create(&shards[index].thread, NULL, shard_run, shards + index))
+			{
+			perror("pthread_create");
+			return 1;
+			}
+
+	shard_run(shards);
+	return 0;
+	}
+
+
+/* MinesweeperDaemon.c EOF */
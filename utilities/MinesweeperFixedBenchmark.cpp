@@ -0,0 +1,182 @@
+/* Minesweeper Kit - MinesweeperFixedBenchmark.cpp
+   __  __
+  /  \/  \  __ ___  ____   ______ __ ______ ____ ____  ____ ____
+ /	  \(__)   \/  -_)_/  _/  /  / /  -_)  -_)  _ \/  -_)  _/
+/___/__/__/__/__/_/\___/____/ |______/\___/\___/  ___/\___/__/
+(C) 2012-2018 Manuel Sainz de Baranda y Goñi. /__/
+Released under the terms of the GNU Lesser General Public License v3.
+
+Throughput of the C API against MinesweeperFixed on the classic boards.
+Every game is seeded, so both engines play exactly the same moves on the
+same boards. Two loops are measured after the first click:
+
+- disclose: the safe cells are disclosed in a random order that is played
+  once untimed, and only the moves that disclosed something are replayed
+  after a restart and timed.
+- hint+disclose: a hint is asked for and disclosed until the game ends.
+
+Preparing the games, the first click and drawing the moves are not timed.
+It prints the best moves per second of each engine over a few runs and the
+ratio between them. */
+
+#include <games/puzzle/Minesweeper.hpp>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RUN_COUNT 3
+
+
+template <zuint X, zuint Y, zuint MINE_COUNT> class Generic {
+	Minesweeper _object;
+
+	public:
+
+	Generic()
+		{minesweeper_initialize(&_object);}
+
+
+	~Generic()
+		{minesweeper_finalize(&_object);}
+
+
+	void prepare()
+		{minesweeper_prepare(&_object, z_2d_type(UINT)(X, Y), MINE_COUNT);}
+
+
+	void restart()
+		{minesweeper_restart(&_object);}
+
+
+	MinesweeperCell cell(zuint x, zuint y) const
+		{return minesweeper_cell(&_object, z_2d_type(UINT)(x, y));}
+
+
+	MinesweeperResult disclose(zuint x, zuint y)
+		{return minesweeper_disclose(&_object, z_2d_type(UINT)(x, y));}
+
+
+	zboolean hint(Z2DUInt *coordinates)
+		{return minesweeper_hint(&_object, coordinates);}
+};
+
+
+static double now()
+	{
+	struct timespec time;
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (double)time.tv_sec + (double)time.tv_nsec / 1E9;
+	}
+
+
+template <zuint X, zuint Y, class Engine> static double moves_per_second(zuint game_count, zboolean hints)
+	{
+	static Z2DUInt cells[X * Y];
+	Engine engine;
+	Z2DUInt point, swap;
+	zuint64 move_count = 0;
+	zuint game, count, move, index;
+	unsigned seed;
+	double time = 0, start;
+
+	for (game = 0; game < game_count; game++)
+		{
+		srandom(game);
+		seed = game;
+		engine.prepare();
+		engine.disclose(X / 2, Y / 2);
+
+		if (hints)
+			{
+			start = now();
+
+			for (move = 0; engine.hint(&point);)
+				{
+				move++;
+				if (engine.disclose(point.x, point.y)) break;
+				}
+
+			time += now() - start;
+			}
+
+		else	{
+			for (count = 0, point.y = 0; point.y < Y; point.y++)
+				for (point.x = 0; point.x < X; point.x++)
+					if (!(engine.cell(point.x, point.y) & MINESWEEPER_CELL_MASK_MINE))
+						cells[count++] = point;
+
+			for (index = count; index > 1; index--)
+				{
+				swap		 = cells[move = (zuint)rand_r(&seed) % index];
+				cells[move]	 = cells[index - 1];
+				cells[index - 1] = swap;
+				}
+
+			/*------------------------------------------------------.
+			| The first click is disclosed again after the restart, |
+			| then only the cells that were still covered.	        |
+			'------------------------------------------------------*/
+			for (move = 1, index = 0; index < count; index++)
+				if (engine.disclose(cells[index].x, cells[index].y) != MINESWEEPER_RESULT_ALREADY_DISCLOSED)
+					cells[move++] = cells[index];
+
+			cells[0] = z_2d_type(UINT)(X / 2, Y / 2);
+			engine.restart();
+			start = now();
+			for (index = 0; index < move; index++) engine.disclose(cells[index].x, cells[index].y);
+			time += now() - start;
+			}
+
+		move_count += move;
+		}
+
+	return (double)move_count / time;
+	}
+
+
+template <zuint X, zuint Y, zuint MINE_COUNT> static void benchmark(zuint game_count)
+	{
+	static char const *loops[2] = {"disclose", "hint+disclose"};
+	double generic, fixed, value;
+	int hints, run;
+
+	for (hints = 0; hints < 2; hints++)
+		{
+		for (generic = fixed = 0, run = 0; run < RUN_COUNT; run++)
+			{
+			value = moves_per_second<X, Y, Generic<X, Y, MINE_COUNT> >(game_count, hints);
+			if (value > generic) generic = value;
+			value = moves_per_second<X, Y, MinesweeperFixed<X, Y, MINE_COUNT> >(game_count, hints);
+			if (value > fixed) fixed = value;
+			}
+
+		printf(	"%2ux%2u/%2u %-13s C %11.0f  C++ %11.0f moves/s  %.2fx\n",
+			X, Y, MINE_COUNT, loops[hints], generic, fixed, fixed / generic);
+		}
+	}
+
+
+int main(int argc, char **argv)
+	{
+	zuint game_count = 5000;
+	int option;
+
+	while ((option = getopt(argc, argv, "g:")) != -1) switch (option)
+		{
+		case 'g': game_count = (zuint)atoi(optarg); break;
+
+		default:
+		fprintf(stderr, "usage: %s [-g games]\n", argv[0]);
+		return 1;
+		}
+
+	benchmark< 9,  9, 10>(game_count);
+	benchmark<16, 16, 40>(game_count);
+	benchmark<30, 16, 99>(game_count);
+	return 0;
+	}
+
+
+/* MinesweeperFixedBenchmark.cpp EOF */
@@ -0,0 +1,154 @@
+/* Minesweeper Kit - MinesweeperFixedCheck.cpp
+   __  __
+  /  \/  \  __ ___  ____   ______ __ ______ ____ ____  ____ ____
+ /	  \(__)   \/  -_)_/  _/  /  / /  -_)  -_)  _ \/  -_)  _/
+/___/__/__/__/__/_/\___/____/ |______/\___/\___/  ___/\___/__/
+(C) 2012-2018 Manuel Sainz de Baranda y Goñi. /__/
+Released under the terms of the GNU Lesser General Public License v3.
+
+Equivalence check between the C API and MinesweeperFixed. Both engines play
+the same seeded games move by move (disclose, toggle flag and hint, with a
+high share of flags so openings are often partly flagged) and the results,
+the state, the counters and the snapshots are compared after every move.
+Only one disclosure of a mine in 16 is played, so most games last long
+enough for flags to cut openings that are disclosed later. Each game is
+also restarted once at a random move, which covers the restart and the
+next preparation of a board of the same size with only its played rows
+dirty.
+The games alternate between building the openings index of the C side
+after the first move or not, and between eager and lazy warnings, so every
+disclosure path of the library is compared. It exits with 1 at the first
+difference, printing the board, the game and the move. */
+
+#include <games/puzzle/Minesweeper.hpp>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MOVES_PER_GAME 400
+
+
+template <zuint X, zuint Y, zuint MINE_COUNT> static zboolean check(zuint game_count)
+	{
+	static zuint8 c_snapshot[sizeof(MinesweeperSnapshotHeader) + X * Y];
+	static zuint8 fixed_snapshot[sizeof(c_snapshot)];
+	MinesweeperFixed<X, Y, MINE_COUNT> fixed;
+	Minesweeper minesweeper;
+	Z2DUInt c_point, fixed_point;
+	zuint game, move, restart_move, x, y;
+	unsigned seed = 1;
+	long state;
+	int c_result, fixed_result;
+	zboolean same_hint;
+
+	minesweeper_initialize(&minesweeper);
+
+	for (game = 0; game < game_count; game++)
+		{
+		srandom(game);
+		minesweeper_set_lazy_warnings(&minesweeper, (game & 2) != 0);
+		minesweeper_prepare(&minesweeper, z_2d_type(UINT)(X, Y), MINE_COUNT);
+		fixed.prepare();
+		restart_move = (zuint)rand_r(&seed) % (MOVES_PER_GAME / 8);
+
+		for (move = 0; move < MOVES_PER_GAME; move++)
+			{
+			same_hint = TRUE;
+			x = (zuint)rand_r(&seed) % X;
+			y = (zuint)rand_r(&seed) % Y;
+
+			/*--------------------------------------------------------.
+			| Both engines draw from random() when disclosing the	  |
+			| first cell and when giving a hint, so the generator is  |
+			| reseeded with the same value before each side plays.	  |
+			'--------------------------------------------------------*/
+			if (move == restart_move)
+				{
+				minesweeper_restart(&minesweeper);
+				fixed.restart();
+				c_result = fixed_result = Z_OK;
+				}
+
+			else switch (rand_r(&seed) % 8)
+				{
+				case 0: case 1: case 2:
+				c_result     = minesweeper_toggle_flag(&minesweeper, z_2d_type(UINT)(x, y), NULL);
+				fixed_result = fixed.toggle_flag(x, y);
+				break;
+
+				case 3:
+				srandom(state = random());
+				c_result = minesweeper_hint(&minesweeper, &c_point);
+				srandom(state);
+				fixed_result = fixed.hint(&fixed_point);
+
+				if (c_result && fixed_result)
+					same_hint = c_point.x == fixed_point.x && c_point.y == fixed_point.y;
+
+				break;
+
+				default:
+				if (	(minesweeper_cell(&minesweeper, z_2d_type(UINT)(x, y)) & MINESWEEPER_CELL_MASK_MINE) &&
+					rand_r(&seed) % 16
+				)
+					continue;
+
+				srandom(state = random());
+				c_result = minesweeper_disclose(&minesweeper, z_2d_type(UINT)(x, y));
+				srandom(state);
+				fixed_result = fixed.disclose(x, y);
+				break;
+				}
+
+			if (!move && (game & 1)) minesweeper_3bv(&minesweeper);
+			minesweeper_snapshot(&minesweeper, c_snapshot);
+			fixed.snapshot(fixed_snapshot);
+
+			if (	!same_hint					     ||
+				c_result		  != fixed_result	     ||
+				minesweeper.state	  != fixed.state()	     ||
+				minesweeper.flag_count	  != fixed.flag_count()	     ||
+				minesweeper.remaining_count != fixed.remaining_count() ||
+				memcmp(c_snapshot, fixed_snapshot, sizeof(c_snapshot))
+			)
+				{
+				printf(	"%ux%u/%u: game %u differs at move %u (%u, %u)\n",
+					X, Y, MINE_COUNT, game, move, x, y);
+
+				minesweeper_finalize(&minesweeper);
+				return FALSE;
+				}
+
+			if (minesweeper.state > MINESWEEPER_STATE_PLAYING) break;
+			}
+		}
+
+	minesweeper_finalize(&minesweeper);
+	printf("%ux%u/%u: %u games match\n", X, Y, MINE_COUNT, game_count);
+	return TRUE;
+	}
+
+
+int main(int argc, char **argv)
+	{
+	zuint game_count = 5000;
+	int option;
+
+	while ((option = getopt(argc, argv, "g:")) != -1) switch (option)
+		{
+		case 'g': game_count = (zuint)atoi(optarg); break;
+
+		default:
+		fprintf(stderr, "usage: %s [-g games]\n", argv[0]);
+		return 1;
+		}
+
+	return	check< 9,  9, 10>(game_count) &&
+		check<16, 16, 40>(game_count) &&
+		check<30, 16, 99>(game_count)
+		? 0 : 1;
+	}
+
+
+/* MinesweeperFixedCheck.cpp EOF */
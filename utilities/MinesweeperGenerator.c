@@ -0,0 +1,370 @@
+/* Minesweeper Kit - MinesweeperGenerator.c
+   __  __
+  /  \/  \  __ ___  ____   ______ __ ______ ____ ____  ____ ____
+ /	  \(__)   \/  -_)_/  _/  /  / /  -_)  -_)  _ \/  -_)  _/
+/___/__/__/__/__/_/\___/____/ |______/\___/\___/  ___/\___/__/
+(C) 2012-2018 Manuel Sainz de Baranda y Goñi. /__/
+Released under the terms of the GNU Lesser General Public License v3.
+
+Each queue is a bounded multi-producer multi-consumer ring: every slot has
+a sequence number that tells whether it is free for the producer of a given
+position or ready for its consumer, so the positions are claimed with one
+compare-and-swap and no lock is ever taken to produce or consume a layout.
+The workers sleep on a condition variable only when all the queues are full,
+and are woken when a queue drops to half of its size. */
+
+#include "MinesweeperGenerator.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+
+#define CACHE_LINE_SIZE 64
+#define LOW_WATER_MARK(queue) (((queue)->mask + 1) / 2)
+
+typedef struct {
+	atomic_size_t sequence;
+	zuint*	      mines;
+} Slot;
+
+struct MinesweeperGeneratorQueue {
+	_Alignas(CACHE_LINE_SIZE) atomic_size_t head;
+	_Alignas(CACHE_LINE_SIZE) atomic_size_t tail;
+
+	_Alignas(CACHE_LINE_SIZE)
+	MinesweeperGeneratorConfiguration configuration;
+	Z2DUInt				  safe_size;
+	Slot*				  slots;
+	zusize				  mask;
+	zuint*				  mines;
+};
+
+
+static zboolean queue_is_full(MinesweeperGeneratorQueue *queue)
+	{
+	return	atomic_load_explicit(&queue->tail, memory_order_relaxed) -
+		atomic_load_explicit(&queue->head, memory_order_relaxed) > queue->mask;
+	}
+
+
+static zboolean queue_push(MinesweeperGeneratorQueue *queue, zuint const *mines)
+	{
+	zusize position = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+	ssize_t difference;
+	Slot *slot;
+
+	for (;;)
+		{
+		slot	   = queue->slots + (position & queue->mask);
+		difference = (ssize_t)(atomic_load_explicit(&slot->sequence, memory_order_acquire) - position);
+
+		if (!difference)
+			{
+			if (atomic_compare_exchange_weak_explicit(
+				&queue->tail, &position, position + 1,
+				memory_order_relaxed, memory_order_relaxed)
+			)
+				break;
+			}
+
+		else if (difference < 0) return FALSE;
+		else position = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+		}
+
+	memcpy(slot->mines, mines, queue->configuration.mine_count * sizeof(zuint));
+	atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+	return TRUE;
+	}
+
+
+static zboolean queue_pop(MinesweeperGeneratorQueue *queue, zuint *mines, zusize *remaining)
+	{
+	zusize position = atomic_load_explicit(&queue->head, memory_order_relaxed);
+	ssize_t difference;
+	Slot *slot;
+
+	for (;;)
+		{
+		slot	   = queue->slots + (position & queue->mask);
+		difference = (ssize_t)(atomic_load_explicit(&slot->sequence, memory_order_acquire) - (position + 1));
+
+		if (!difference)
+			{
+			if (atomic_compare_exchange_weak_explicit(
+				&queue->head, &position, position + 1,
+				memory_order_relaxed, memory_order_relaxed)
+			)
+				break;
+			}
+
+		else if (difference < 0) return FALSE;
+		else position = atomic_load_explicit(&queue->head, memory_order_relaxed);
+		}
+
+	memcpy(mines, slot->mines, queue->configuration.mine_count * sizeof(zuint));
+	atomic_store_explicit(&slot->sequence, position + queue->mask + 1, memory_order_release);
+	*remaining = atomic_load_explicit(&queue->tail, memory_order_relaxed) - position - 1;
+	return TRUE;
+	}
+
+
+static zuint64 next_random(zuint64 *state)
+	{
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return *state * 0x2545F4914F6CDD1DULL;
+	}
+
+
+/*------------------------------------------------------------------------.
+| Places the mines of the queue uniformly out of its safe rectangle at	  |
+| (0, 0). `used` has one bit per cell and is left clear for the next	  |
+| layout.								  |
+'------------------------------------------------------------------------*/
+static void generate(MinesweeperGeneratorQueue const *queue, zuint *mines, zuint8 *used, zuint64 *seed)
+	{
+	Z2DUInt size = queue->configuration.size;
+	zuint cell_count = size.x * size.y, count, index;
+
+	for (count = 0; count != queue->configuration.mine_count;)
+		{
+		index = (zuint)(((next_random(seed) >> 32) * cell_count) >> 32);
+
+		if (	(index >= size.x * queue->safe_size.y || index % size.x >= queue->safe_size.x) &&
+			!(used[index >> 3] & (1 << (index & 7)))
+		)
+			{
+			used[index >> 3] |= (zuint8)(1 << (index & 7));
+			mines[count++] = index;
+			}
+		}
+
+	while (count) used[mines[--count] >> 3] = 0;
+	}
+
+
+static zboolean all_full(MinesweeperGenerator *object)
+	{
+	zuint index;
+
+	for (index = 0; index < object->queue_count; index++)
+		if (!queue_is_full(object->queues + index)) return FALSE;
+
+	return TRUE;
+	}
+
+
+static void *worker_run(void *context)
+	{
+	MinesweeperGenerator *object = context;
+	MinesweeperGeneratorQueue *queue;
+	zuint *mines, index, mine_count = 0, cell_count = 0;
+	zuint8 *used;
+	zuint64 seed;
+	struct timespec time;
+	zboolean produced;
+
+	for (index = 0; index < object->queue_count; index++)
+		{
+		queue = object->queues + index;
+
+		if (queue->configuration.mine_count > mine_count)
+			mine_count = queue->configuration.mine_count;
+
+		if (queue->configuration.size.x * queue->configuration.size.y > cell_count)
+			cell_count = queue->configuration.size.x * queue->configuration.size.y;
+		}
+
+	if (	(mines = malloc(mine_count * sizeof(zuint))) == NULL ||
+		(used  = calloc(cell_count / 8 + 1, 1))	     == NULL
+	)
+		{
+		free(mines);
+		return NULL;
+		}
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	seed = ((zuint64)time.tv_sec * 1000000000 + (zuint64)time.tv_nsec) ^ (zuint64)(zusize)&time;
+	if (!seed) seed = 1;
+
+	while (!atomic_load_explicit(&object->stop, memory_order_relaxed))
+		{
+		for (produced = FALSE, index = 0; index < object->queue_count; index++)
+			if (!queue_is_full(queue = object->queues + index))
+				{
+				generate(queue, mines, used, &seed);
+				produced |= queue_push(queue, mines);
+				}
+
+		/*-----------------------------------------------------------.
+		| The consumers look at `idle_count` after taking a layout,  |
+		| so the queues are checked again once it is incremented.    |
+		'-----------------------------------------------------------*/
+		if (!produced)
+			{
+			pthread_mutex_lock(&object->mutex);
+			atomic_fetch_add(&object->idle_count, 1);
+			atomic_thread_fence(memory_order_seq_cst);
+
+			if (!atomic_load(&object->stop) && all_full(object))
+				pthread_cond_wait(&object->condition, &object->mutex);
+
+			atomic_fetch_sub(&object->idle_count, 1);
+			pthread_mutex_unlock(&object->mutex);
+			}
+		}
+
+	free(mines);
+	free(used);
+	return NULL;
+	}
+
+
+ZStatus minesweeper_generator_initialize(
+	MinesweeperGenerator*			 object,
+	MinesweeperGeneratorConfiguration const* configurations,
+	zuint					 configuration_count,
+	zuint					 queue_size,
+	zuint					 thread_count
+)
+	{
+	MinesweeperGeneratorQueue *queue;
+	zusize capacity = 1, index;
+
+	while (capacity < queue_size) capacity *= 2;
+
+	object->queue_count  = 0;
+	object->thread_count = 0;
+	object->threads	     = NULL;
+	atomic_init(&object->idle_count, 0);
+	atomic_init(&object->stop, FALSE);
+
+	if ((object->queues = aligned_alloc(
+		CACHE_LINE_SIZE, configuration_count * 4 * sizeof(MinesweeperGeneratorQueue))
+	) == NULL)
+		return Z_ERROR_NOT_ENOUGH_MEMORY;
+
+	/*----------------------------------------------------------.
+	| Every configuration has a queue per safe rectangle: 2x2,  |
+	| 3x2, 2x3 and 3x3, for the corners, the top and bottom	    |
+	| borders, the left and right borders and the inner cells.  |
+	'----------------------------------------------------------*/
+	for (; object->queue_count < configuration_count * 4; object->queue_count++)
+		{
+		queue = object->queues + object->queue_count;
+		queue->configuration = configurations[object->queue_count / 4];
+		queue->safe_size.x   = 2 + (object->queue_count & 1);
+		queue->safe_size.y   = 2 + ((object->queue_count >> 1) & 1);
+		queue->mask	     = capacity - 1;
+		queue->mines	     = NULL;
+		atomic_init(&queue->head, 0);
+		atomic_init(&queue->tail, 0);
+
+		if (	(queue->slots = malloc(capacity * sizeof(Slot))) == NULL ||
+			(queue->mines = malloc(capacity * queue->configuration.mine_count * sizeof(zuint))) == NULL
+		)
+			{
+			object->queue_count++;
+			minesweeper_generator_finalize(object);
+			return Z_ERROR_NOT_ENOUGH_MEMORY;
+			}
+
+		for (index = 0; index < capacity; index++)
+			{
+			atomic_init(&queue->slots[index].sequence, index);
+			queue->slots[index].mines = queue->mines + index * queue->configuration.mine_count;
+			}
+		}
+
+	pthread_mutex_init(&object->mutex, NULL);
+	pthread_cond_init(&object->condition, NULL);
+
+	if ((object->threads = malloc(thread_count * sizeof(pthread_t))) == NULL)
+		{
+		minesweeper_generator_finalize(object);
+		return Z_ERROR_NOT_ENOUGH_MEMORY;
+		}
+
+	for (; object->thread_count < thread_count; object->thread_count++)
+		if (pthread_create(
+			object->threads + object->thread_count, NULL,
+			worker_run, object)
+		)
+			{
+			minesweeper_generator_finalize(object);
+			return Z_ERROR_NOT_ENOUGH_MEMORY;
+			}
+
+	return Z_OK;
+	}
+
+
+void minesweeper_generator_finalize(MinesweeperGenerator *object)
+	{
+	zuint index;
+
+	if (object->threads != NULL)
+		{
+		atomic_store(&object->stop, TRUE);
+		pthread_mutex_lock(&object->mutex);
+		pthread_cond_broadcast(&object->condition);
+		pthread_mutex_unlock(&object->mutex);
+		for (index = 0; index < object->thread_count; index++) pthread_join(object->threads[index], NULL);
+		free(object->threads);
+		pthread_cond_destroy(&object->condition);
+		pthread_mutex_destroy(&object->mutex);
+		}
+
+	for (index = 0; index < object->queue_count; index++)
+		{
+		free(object->queues[index].slots);
+		free(object->queues[index].mines);
+		}
+
+	free(object->queues);
+	}
+
+
+/*------------------------------------------------------------------------.
+| A MinesweeperLayoutSource whose context is the generator. The workers	  |
+| are woken only when the queue drops to its low-water mark, so they	  |
+| refill it in batches instead of after every layout taken.		  |
+'------------------------------------------------------------------------*/
+zboolean minesweeper_generator_take(
+	void*		   context,
+	Minesweeper const* minesweeper,
+	Z2DUInt		   safe_size,
+	zuint*		   mines
+)
+	{
+	MinesweeperGenerator *object = context;
+	MinesweeperGeneratorQueue *queue = object->queues, *end = queue + object->queue_count;
+	zusize remaining;
+
+	for (; queue != end; queue++) if (
+		queue->configuration.size.x	== minesweeper->size.x &&
+		queue->configuration.size.y	== minesweeper->size.y &&
+		queue->configuration.mine_count == minesweeper->mine_count &&
+		queue->safe_size.x		== safe_size.x		   &&
+		queue->safe_size.y		== safe_size.y
+	)
+		{
+		if (!queue_pop(queue, mines, &remaining)) return FALSE;
+		atomic_thread_fence(memory_order_seq_cst);
+
+		if (remaining <= LOW_WATER_MARK(queue) && atomic_load(&object->idle_count))
+			{
+			pthread_mutex_lock(&object->mutex);
+			pthread_cond_broadcast(&object->condition);
+			pthread_mutex_unlock(&object->mutex);
+			}
+
+		return TRUE;
+		}
+
+	return FALSE;
+	}
+
+
+/* MinesweeperGenerator.c EOF */
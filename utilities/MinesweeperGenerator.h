@@ -0,0 +1,67 @@
+/* Minesweeper Kit - MinesweeperGenerator.h
+   __  __
+  /  \/  \  __ ___  ____   ______ __ ______ ____ ____  ____ ____
+ /	  \(__)   \/  -_)_/  _/  /  / /  -_)  -_)  _ \/  -_)  _/
+/___/__/__/__/__/_/\___/____/ |______/\___/\___/  ___/\___/__/
+(C) 2012-2018 Manuel Sainz de Baranda y Goñi. /__/
+Released under the terms of the GNU Lesser General Public License v3. */
+
+#ifndef __MinesweeperGenerator_H__
+#define __MinesweeperGenerator_H__
+
+#include <Z/types/base.h>
+#include <Z/keys/status.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#ifdef MINESWEEPER_USE_LOCAL_HEADER
+#	include "Minesweeper.h"
+#else
+#	include <games/puzzle/Minesweeper.h>
+#endif
+
+#ifndef MINESWEEPER_USE_LAYOUT_SOURCE
+#	error "The generator requires MINESWEEPER_USE_LAYOUT_SOURCE"
+#endif
+
+/*----------------------------------------------------------------------------.
+| Background generator of mine layouts. Worker threads keep a bounded queue   |
+| of ready layouts per configuration and safe rectangle (2x2, 3x2, 2x3 and    |
+| 3x3); the games get them by installing `minesweeper_generator_take` as      |
+| their layout source, with the generator as context. Taking a layout never   |
+| blocks: if the queue is empty or there is no queue for the configuration,   |
+| the library places the mines itself.					      |
+'============================================================================*/
+
+typedef struct {
+	Z2DUInt size;
+	zuint	mine_count;
+} MinesweeperGeneratorConfiguration;
+
+typedef struct MinesweeperGeneratorQueue MinesweeperGeneratorQueue;
+
+typedef struct {
+	MinesweeperGeneratorQueue* queues;
+	zuint			   queue_count;
+	pthread_t*		   threads;
+	zuint			   thread_count;
+	pthread_mutex_t		   mutex;
+	pthread_cond_t		   condition;
+	atomic_uint		   idle_count;
+	atomic_bool		   stop;
+} MinesweeperGenerator;
+
+ZStatus	 minesweeper_generator_initialize(MinesweeperGenerator*			   object,
+					  MinesweeperGeneratorConfiguration const* configurations,
+					  zuint					   configuration_count,
+					  zuint					   queue_size,
+					  zuint					   thread_count);
+
+void	 minesweeper_generator_finalize	 (MinesweeperGenerator*			   object);
+
+zboolean minesweeper_generator_take	 (void*					   context,
+					  Minesweeper const*			   minesweeper,
+					  Z2DUInt				   safe_size,
+					  zuint*				   mines);
+
+#endif /* __MinesweeperGenerator_H__ */
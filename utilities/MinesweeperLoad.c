@@ -0,0 +1,401 @@
+/* Minesweeper Kit - MinesweeperLoad.c
+   __  __
+  /  \/  \  __ ___  ____   ______ __ ______ ____ ____  ____ ____
+ /	  \(__)   \/  -_)_/  _/  /  / /  -_)  -_)  _ \/  -_)  _/
+/___/__/__/__/__/_/\___/____/ |______/\___/\___/  ___/\___/__/
+(C) 2012-2018 Manuel Sainz de Baranda y Goñi. /__/
+Released under the terms of the GNU Lesser General Public License v3.
+
+Load generator for the reference daemon. Every connection creates a game
+and keeps a fixed number of requests in flight (a mix of prepare, disclose,
+toggle flag and hint), refilling the pipeline with one write each time
+responses arrive. At the end it prints the requests per second and the
+latency percentiles, measured from the write of a request to the read of
+its response. */
+
+#define _GNU_SOURCE
+
+#include "MinesweeperProtocol.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAXIMUM_DEPTH	  4096
+#define MAXIMUM_SAMPLES	  (1 << 24)
+#define REQUEST_SIZE	  ((zusize)sizeof(MinesweeperProtocolRequest))
+#define RESPONSE_SIZE	  ((zusize)sizeof(MinesweeperProtocolResponse))
+#define MAXIMUM_REQUEST	  (REQUEST_SIZE + sizeof(MinesweeperProtocolPrepare))
+
+typedef struct {
+	int	 fd;
+	zuint32	 game;
+	zuint	 in_flight;
+	zuint	 sent_count;
+	zuint64	 sent_times[MAXIMUM_DEPTH];
+	zuint	 sent_head;
+	zuint8*	 input;
+	zusize	 input_size;
+	zusize	 input_capacity;
+	unsigned seed;
+} Client;
+
+static struct {
+	Z2DUInt	 size;
+	zuint	 mine_count;
+	zuint	 depth;
+	zuint64* samples;
+	zusize	 sample_count;
+	zuint64	 response_count;
+} load;
+
+
+static zuint64 now(void)
+	{
+	struct timespec time;
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (zuint64)time.tv_sec * 1000000000u + (zuint64)time.tv_nsec;
+	}
+
+
+static zusize write_request(
+	zuint8*	    output,
+	zuint32	    game,
+	zuint8	    command,
+	void const* payload,
+	zuint16	    payload_size
+)
+	{
+	MinesweeperProtocolRequest *request = (MinesweeperProtocolRequest *)output;
+
+	request->game	      = htonl(game);
+	request->command      = command;
+	request->reserved     = 0;
+	request->payload_size = htons(payload_size);
+	if (payload_size) memcpy(output + REQUEST_SIZE, payload, payload_size);
+	return REQUEST_SIZE + payload_size;
+	}
+
+
+/*-----------------------------------------------------------------.
+| Fills the pipeline of a client with one write. Roughly 1 of 64   |
+| requests starts a new game, 1 of 8 asks for a hint, 1 of 8	   |
+| toggles a flag and the rest disclose random cells.		   |
+'-----------------------------------------------------------------*/
+static zboolean client_refill(Client *client)
+	{
+	static zuint8 output[MAXIMUM_DEPTH * MAXIMUM_REQUEST];
+	zusize size = 0, sent;
+	zuint64 time;
+	zuint kind;
+	ssize_t result;
+
+	if (client->in_flight == load.depth) return TRUE;
+
+	while (client->in_flight + client->sent_count < load.depth)
+		{
+		kind = client->sent_count++ + (zuint)rand_r(&client->seed);
+
+		if (!(kind % 64))
+			{
+			MinesweeperProtocolPrepare prepare;
+
+			prepare.x	   = htonl(load.size.x);
+			prepare.y	   = htonl(load.size.y);
+			prepare.mine_count = htonl(load.mine_count);
+
+			size += write_request
+				(output + size, client->game, MINESWEEPER_PROTOCOL_COMMAND_PREPARE,
+				 &prepare, sizeof(prepare));
+			}
+
+		else if (!(kind % 8)) size += write_request
+			(output + size, client->game, MINESWEEPER_PROTOCOL_COMMAND_HINT, NULL, 0);
+
+		else	{
+			MinesweeperProtocolPoint point;
+
+			point.x = htonl((zuint)rand_r(&client->seed) % load.size.x);
+			point.y = htonl((zuint)rand_r(&client->seed) % load.size.y);
+
+			size += write_request
+				(output + size, client->game,
+				 kind % 8 == 1
+					? MINESWEEPER_PROTOCOL_COMMAND_TOGGLE_FLAG
+					: MINESWEEPER_PROTOCOL_COMMAND_DISCLOSE,
+				 &point, sizeof(point));
+			}
+		}
+
+	time = now();
+
+	for (sent = 0; sent < size; sent += (zusize)result)
+		if ((result = send(client->fd, output + sent, size - sent, MSG_NOSIGNAL)) < 0)
+			{
+			if (errno == EINTR) result = 0;
+			else return FALSE;
+			}
+
+	while (client->sent_count)
+		{
+		client->sent_times[(client->sent_head + client->in_flight++) % MAXIMUM_DEPTH] = time;
+		client->sent_count--;
+		}
+
+	return TRUE;
+	}
+
+
+static zboolean client_read(Client *client, zboolean measure)
+	{
+	MinesweeperProtocolResponse const *response;
+	zusize offset, size;
+	zuint64 time;
+	ssize_t received;
+
+	if (client->input_capacity - client->input_size < 65536)
+		{
+		void *input = realloc(client->input, client->input_capacity += 65536 * 4);
+
+		if (input == NULL) return FALSE;
+		client->input = input;
+		}
+
+	if ((received = recv(
+		client->fd, client->input + client->input_size,
+		client->input_capacity - client->input_size, 0)
+	) <= 0)
+		return received < 0 && (errno == EAGAIN || errno == EINTR);
+
+	client->input_size += (zusize)received;
+	time = now();
+
+	for (	offset = 0;
+		client->input_size - offset >= RESPONSE_SIZE &&
+		client->input_size - offset >=
+		(size = RESPONSE_SIZE + ntohl(((MinesweeperProtocolResponse const *)
+			(client->input + offset))->payload_size));
+		offset += size
+	)
+		{
+		response = (MinesweeperProtocolResponse const *)(client->input + offset);
+
+		if (response->command == MINESWEEPER_PROTOCOL_COMMAND_CREATE)
+			client->game = ntohl(response->game);
+
+		else if (measure)
+			{
+			if (load.sample_count < MAXIMUM_SAMPLES) load.samples[load.sample_count++] =
+				time - client->sent_times[client->sent_head % MAXIMUM_DEPTH];
+
+			load.response_count++;
+			}
+
+		client->sent_head = (client->sent_head + 1) % MAXIMUM_DEPTH;
+		client->in_flight--;
+		}
+
+	memmove(client->input, client->input + offset, client->input_size -= offset);
+	return TRUE;
+	}
+
+
+static int client_connect(char const *unix_path, int port)
+	{
+	int fd, yes = 1;
+
+	if (unix_path != NULL)
+		{
+		struct sockaddr_un address;
+
+		memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		strncpy(address.sun_path, unix_path, sizeof(address.sun_path) - 1);
+
+		if (	(fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0 ||
+			connect(fd, (struct sockaddr *)&address, sizeof(address))
+		)
+			return -1;
+		}
+
+	else	{
+		struct sockaddr_in address;
+
+		memset(&address, 0, sizeof(address));
+		address.sin_family	= AF_INET;
+		address.sin_port	= htons((zuint16)port);
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		if (	(fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0 ||
+			connect(fd, (struct sockaddr *)&address, sizeof(address))
+		)
+			return -1;
+
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+		}
+
+	return fd;
+	}
+
+
+static int compare_samples(void const *a, void const *b)
+	{
+	zuint64 x = *(zuint64 const *)a, y = *(zuint64 const *)b;
+
+	return x < y ? -1 : x > y;
+	}
+
+
+int main(int argc, char **argv)
+	{
+	struct epoll_event event, events[256];
+	char const *unix_path = NULL;
+	int port = MINESWEEPER_PROTOCOL_DEFAULT_PORT, client_count = 4, seconds = 5, option, index, count;
+	zuint64 start, end, warm_up;
+	Client *clients;
+	int epoll;
+
+	load.size.x	= 30;
+	load.size.y	= 16;
+	load.mine_count = 99;
+	load.depth	= 32;
+
+	while ((option = getopt(argc, argv, "u:p:c:d:s:x:y:m:")) != -1) switch (option)
+		{
+		case 'u': unix_path	  = optarg;		break;
+		case 'p': port		  = atoi(optarg);	break;
+		case 'c': client_count	  = atoi(optarg);	break;
+		case 'd': load.depth	  = (zuint)atoi(optarg); break;
+		case 's': seconds	  = atoi(optarg);	break;
+		case 'x': load.size.x	  = (zuint)atoi(optarg); break;
+		case 'y': load.size.y	  = (zuint)atoi(optarg); break;
+		case 'm': load.mine_count = (zuint)atoi(optarg); break;
+
+		default:
+		fprintf(stderr,
+			"usage: %s [-u unix_socket | -p port] [-c connections] [-d depth]\n"
+			"       [-s seconds] [-x width] [-y height] [-m mines]\n", argv[0]);
+		return 1;
+		}
+
+	if (load.depth < 1 || load.depth > MAXIMUM_DEPTH || client_count < 1)
+		{
+		fputs("invalid depth or connection count\n", stderr);
+		return 1;
+		}
+
+	if (	(clients = calloc((zusize)client_count, sizeof(Client))) == NULL ||
+		(load.samples = malloc(MAXIMUM_SAMPLES * sizeof(zuint64))) == NULL ||
+		(epoll = epoll_create1(EPOLL_CLOEXEC)) < 0
+	)
+		return 1;
+
+	/*---------------------------------------------------------------.
+	| Create and prepare one game per connection before starting	|
+	| the pipelines.						|
+	'---------------------------------------------------------------*/
+	for (index = 0; index < client_count; index++)
+		{
+		zuint8 request[MAXIMUM_REQUEST];
+		MinesweeperProtocolPrepare prepare;
+		Client *client = clients + index;
+
+		if ((client->fd = client_connect(unix_path, port)) < 0)
+			{
+			perror("connect");
+			return 1;
+			}
+
+		client->seed = (unsigned)index + 1;
+		write_request(request, 0, MINESWEEPER_PROTOCOL_COMMAND_CREATE, NULL, 0);
+
+		if (send(client->fd, request, REQUEST_SIZE, MSG_NOSIGNAL) != (ssize_t)REQUEST_SIZE)
+			return 1;
+
+		client->in_flight = 1;
+
+		while (client->in_flight)
+			if (!client_read(client, FALSE)) return 1;
+
+		prepare.x	   = htonl(load.size.x);
+		prepare.y	   = htonl(load.size.y);
+		prepare.mine_count = htonl(load.mine_count);
+
+		write_request
+			(request, client->game, MINESWEEPER_PROTOCOL_COMMAND_PREPARE,
+			 &prepare, sizeof(prepare));
+
+		if (send(client->fd, request, MAXIMUM_REQUEST, MSG_NOSIGNAL) != (ssize_t)MAXIMUM_REQUEST)
+			return 1;
+
+		client->in_flight = 1;
+
+		while (client->in_flight)
+			if (!client_read(client, FALSE)) return 1;
+
+		event.events   = EPOLLIN;
+		event.data.ptr = client;
+		if (epoll_ctl(epoll, EPOLL_CTL_ADD, client->fd, &event)) return 1;
+		}
+
+	/*-----------------------------------------------------------.
+	| The first second is a warm up and it is not measured.      |
+	'-----------------------------------------------------------*/
+	start	= now();
+	warm_up = start + 1000000000u;
+	end	= warm_up + (zuint64)seconds * 1000000000u;
+
+	for (index = 0; index < client_count; index++)
+		if (!client_refill(clients + index)) return 1;
+
+	while (now() < end)
+		{
+		zboolean measure = now() >= warm_up;
+
+		if ((count = epoll_wait(epoll, events, 256, 100)) < 0)
+			{
+			if (errno == EINTR) continue;
+			perror("epoll_wait");
+			return 1;
+			}
+
+		for (index = 0; index < count; index++)
+			{
+			Client *client = events[index].data.ptr;
+
+			if (!client_read(client, measure) || !client_refill(client))
+				{
+				fputs("connection lost\n", stderr);
+				return 1;
+				}
+			}
+		}
+
+	qsort(load.samples, load.sample_count, sizeof(zuint64), compare_samples);
+
+	printf(	"connections %d, depth %u, board %ux%u/%u\n"
+		"%.0f requests/s\n",
+		client_count, load.depth, load.size.x, load.size.y, load.mine_count,
+		(double)load.response_count / seconds);
+
+	if (load.sample_count) printf(
+		"latency p50 %.1f us, p99 %.1f us, p99.9 %.1f us\n",
+		load.samples[load.sample_count / 2			 ] / 1000.0,
+		load.samples[load.sample_count * 99 / 100		 ] / 1000.0,
+		load.samples[load.sample_count - 1 - load.sample_count / 1000] / 1000.0);
+
+	return 0;
+	}
+
+
+/* MinesweeperLoad.c EOF */
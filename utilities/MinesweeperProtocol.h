@@ -0,0 +1,96 @@
+/* Minesweeper Kit - MinesweeperProtocol.h
+   __  __
+  /  \/  \  __ ___  ____   ______ __ ______ ____ ____  ____ ____
+ /	  \(__)   \/  -_)_/  _/  /  / /  -_)  -_)  _ \/  -_)  _/
+/___/__/__/__/__/_/\___/____/ |______/\___/\___/  ___/\___/__/
+(C) 2012-2018 Manuel Sainz de Baranda y Goñi. /__/
+Released under the terms of the GNU Lesser General Public License v3. */
+
+#ifndef __MinesweeperProtocol_H__
+#define __MinesweeperProtocol_H__
+
+#include <Z/types/base.h>
+
+#ifdef MINESWEEPER_USE_LOCAL_HEADER
+#	include "Minesweeper.h"
+#else
+#	include <games/puzzle/Minesweeper.h>
+#endif
+
+/*----------------------------------------------------------------------------.
+| Binary protocol of the reference daemon. Every message is a fixed header    |
+| followed by `payload_size` bytes; all the integers are big endian. Clients  |
+| can pipeline any number of requests, the responses are sent in the same     |
+| order. A game can only be used through the connection that created it, and  |
+| it is destroyed when that connection is closed.			      |
+'============================================================================*/
+
+#define MINESWEEPER_PROTOCOL_DEFAULT_PORT 7373
+
+/*-----------------------------------------------------------------.
+| Commands and request payloads:				   |
+| CREATE      -		  (response header carries the new game)   |
+| DESTROY     -							   |
+| PREPARE     MinesweeperProtocolPrepare			   |
+| RESTART     -		  (response: changed cells)		   |
+| DISCLOSE    MinesweeperProtocolPoint (response: changed cells)   |
+| TOGGLE_FLAG MinesweeperProtocolPoint (response: changed cell)    |
+| HINT	      -		  (response: 1 cell if result is TRUE)	   |
+| SNAPSHOT    -		  (response: `minesweeper_snapshot` data)  |
+'-----------------------------------------------------------------*/
+
+#define MINESWEEPER_PROTOCOL_COMMAND_CREATE	 0
+#define MINESWEEPER_PROTOCOL_COMMAND_DESTROY	 1
+#define MINESWEEPER_PROTOCOL_COMMAND_PREPARE	 2
+#define MINESWEEPER_PROTOCOL_COMMAND_RESTART	 3
+#define MINESWEEPER_PROTOCOL_COMMAND_DISCLOSE	 4
+#define MINESWEEPER_PROTOCOL_COMMAND_TOGGLE_FLAG 5
+#define MINESWEEPER_PROTOCOL_COMMAND_HINT	 6
+#define MINESWEEPER_PROTOCOL_COMMAND_SNAPSHOT	 7
+
+/*-------------------------------------------------------------------.
+| Results: Z_OK, a MinesweeperResult, TRUE/FALSE for HINT, or one of |
+| the following errors.						     |
+'-------------------------------------------------------------------*/
+
+#define MINESWEEPER_PROTOCOL_RESULT_INVALID_ARGUMENT 0xFC
+#define MINESWEEPER_PROTOCOL_RESULT_NOT_ENOUGH_MEMORY 0xFD
+#define MINESWEEPER_PROTOCOL_RESULT_BAD_REQUEST	     0xFE
+#define MINESWEEPER_PROTOCOL_RESULT_UNKNOWN_GAME     0xFF
+
+#define MINESWEEPER_PROTOCOL_MAXIMUM_PAYLOAD_SIZE 1024
+
+Z_DEFINE_STRICT_STRUCTURE(
+	zuint32 game;
+	zuint8	command;
+	zuint8	reserved;
+	zuint16 payload_size;
+) MinesweeperProtocolRequest;
+
+Z_DEFINE_STRICT_STRUCTURE(
+	zuint32 game;
+	zuint8	command;
+	zuint8	result;
+	zuint8	state;
+	zuint8	reserved;
+	zuint32 payload_size;
+) MinesweeperProtocolResponse;
+
+Z_DEFINE_STRICT_STRUCTURE(
+	zuint32 x;
+	zuint32 y;
+	zuint32 mine_count;
+) MinesweeperProtocolPrepare;
+
+Z_DEFINE_STRICT_STRUCTURE(
+	zuint32 x;
+	zuint32 y;
+) MinesweeperProtocolPoint;
+
+Z_DEFINE_STRICT_STRUCTURE(
+	zuint32		x;
+	zuint32		y;
+	MinesweeperCell cell;
+) MinesweeperProtocolCell;
+
+#endif /* __MinesweeperProtocol_H__ */